@@ -0,0 +1,56 @@
+# Benchmark of the decoder's specialized search kernels against the generic one
+#
+# For each code rate, with and without DNA constraints, we encode random strands, create
+# DNA errors, and time decoding them with setsearchoptions(..., specialize) set to 1 and to 0.
+# The two must decode identically; only the time may differ.
+
+from numpy import *
+import time
+import NRpyDNAcode as code
+
+coderates = array([NaN, 0.75, 0.6, 0.5, 1./3., 0.25, 1./6.]
+                  )  # table of coderates 1..6
+
+# user-settable parameters for this benchmark
+nstrands = 200  # strands decoded per timing
+nrepeats = 3  # best of this many timings
+totstrandlen = 300  # total length of DNA strand
+leftprimer = "TCGAAGTCAGCGTGTATTGTATG"
+rightprimer = "TAGTGAGTGCGATTAAGCGTGTT"
+(srate, drate, irate) = 1.0 * array([0.0238, 0.0082, 0.0039])
+constraints = [(12, 8, 4, 4), (0, 0, 0, 0)]  # (GC_window, max_GC, min_GC, max_hpoly_run)
+
+strandlen = totstrandlen - len(leftprimer) - len(rightprimer)
+options = list(code.getsearchoptions())
+random.seed(1)  # the same strands and errors every run, so builds can be compared
+code.setseed(1)
+
+
+def timedecodes(obs, nmessbits, specialize):
+    options[7] = specialize
+    code.setsearchoptions(*options)
+    best = inf
+    for rep in range(nrepeats):
+        start = time.time()
+        results = [code.decode(dna, nmessbits) for dna in obs]
+        best = min(best, time.time() - start)
+    return (best / len(obs), [(r[0], r[1].tostring(), r[2]) for r in results])
+
+
+print "microseconds per strand decode, generic and specialized kernels:"
+for (window, maxgc, mingc, maxrun) in constraints:
+    code.setdnaconstraints(window, maxgc, mingc, maxrun)
+    for coderatecode in range(1, 7):
+        code.setcoderate(coderatecode, leftprimer, rightprimer)
+        nbytes = int(strandlen*coderates[coderatecode]/4.)
+        obs = []
+        for i in range(nstrands):
+            message = random.randint(0, high=256, size=nbytes, dtype=uint8)
+            dna = code.encode(message, totstrandlen)
+            obs.append(code.createerrors(dna, srate, drate, irate))
+        (tgeneric, generic) = timedecodes(obs, 8*nbytes, 0)
+        (tspecial, special) = timedecodes(obs, 8*nbytes, 1)
+        print("%-13s rate %d: %8.1f %8.1f  (%.2fx) %s" % ("unconstrained" if window == 0 else "constrained",
+                                                         coderatecode, 1.e6*tgeneric, 1.e6*tspecial, tgeneric/tspecial,
+                                                         "same decodes" if generic == special else "DECODES DIFFER!"))
+code.restoresearchoptions()
@@ -1,6 +1,9 @@
 #include "nr3python.h"
 #include "heapscheduler.h"
 #include "ran.h"
+#include "hashbatch.h"
+#include "packdna.h"
+#include "readcluster.h"
 
 //  this version 7 is version 6 with bug fixed in decode_c
 //  this version 6 doesn't increment salt, but actually finds allowed output chars
@@ -40,52 +43,90 @@ VecUllong primersalt;
 VecInt pattarr(MAXSEQ + 2, 1); // contains number of bits in each vbit: 0, 1, or 2
 VecUchar pattrn(1, Uchar(1));  // initialize to rate 0.5 (pattnumber=3)
 Int npattrn = 1, lastpattnumber = 3;
+Int PATTERN = 3; // the standard pattern in pattarr, set by setcoderate_C: picks the decoder's kernel (see HedgesDecoder::vbits)
 Int VSALT = NSALT;		   // number of vbits corresponding to NSALT, updated  by setcoderate()
 Int NSP = VSALT + LPRIMER; // updated by setcoderate()
 
-Int DNAWINDOW = 12; // window in which DNA constraints imposed
-Int MAXGC = 8;		// max GC in window
-Int MINGC = 4;		// min GC in window
-Int MAXRUN = 4;		// max length of homopolymers
-GF4reg dnawinmask((Ullong(1) << 2 * DNAWINDOW) - 1);
-GF4reg dnaoldmask((Ullong(1) << 2 * (DNAWINDOW - 1)) - 1); // used to set oldest to "A"
-GF4reg acgtacgt(0x1b1b1b1b1b1b1b1bllu);					   // "ACGTACGTACGTACGT" used for initialization
-
-Uchar dnac_ok[4]; // sadly, another global
-Int dnacallowed(GF4reg prev)
-{
-	// returns the number of allowed ACGTs and puts them in dnac_ok
-	if (DNAWINDOW <= 0)
-	{
-		dnac_ok[0] = 0;
-		dnac_ok[1] = 1;
-		dnac_ok[2] = 2;
-		dnac_ok[3] = 3;
-		return 4;
-	}
-	Int ans, gccount, last = prev & 3, nrun = 1;
-	bool isrun = false;
-	Ullong reg;
-	// get GCcount
-	reg = prev & dnaoldmask;
-	reg = (reg ^ (reg >> 1)) & 0x5555555555555555ull; // makes ones for GC, zeros for AT
-	// popcount inline:
-	reg -= ((reg >> 1) & 0x5555555555555555ull);
-	reg = (reg & 0x3333333333333333ull) + (reg >> 2 & 0x3333333333333333ull);
-	gccount = ((reg + (reg >> 4)) & 0xf0f0f0f0f0f0f0full) * 0x101010101010101ull >> 56; // the popcount
-	// is there a run and, if so, of what
-	reg = (prev >> 2);
-	while ((reg & 3) == last)
-	{
-		++nrun;
-		if (nrun >= MAXRUN)
-		{
-			isrun = true;
-			break;
-		}
-		reg >>= 2;
+// DNA output constraints (GC balance in a window, homopolymer runs).  The global
+// instance dnacon is the current setting; each decoder context keeps its own copy.
+// What is allowed next depends only on the GC count of the window, whether it ends in
+// a run, and its last base, so set() tabulates the answer for every such state.
+struct DNAConstraints
+{
+	Int DNAWINDOW; // window in which DNA constraints imposed
+	Int MAXGC;	   // max GC in window
+	Int MINGC;	   // min GC in window
+	Int MAXRUN;	   // max length of homopolymers
+	GF4reg dnawinmask;
+	GF4reg dnaoldmask; // used to set oldest to "A"
+	GF4reg runmask;	   // the chars that must all equal the last one to make a run
+	struct Choice
+	{
+		Uchar n, ok[4]; // number of allowed ACGTs, and which they are
+	};
+	Choice table[33 * 2 * 4]; // indexed by (gccount, isrun, last base)
+
+	DNAConstraints(Int window = 12, Int maxgc = 8, Int mingc = 4, Int maxrun = 4) { set(window, maxgc, mingc, maxrun); }
+	void set(Int window, Int maxgc, Int mingc, Int maxrun);
+	Int choose(Int gccount, bool isrun, Int last, Uchar *dnac_ok) const;
+	inline Int allowed(GF4reg prev, Uchar *dnac_ok) const
+	{
+		// returns the number of allowed ACGTs and puts them in dnac_ok
+		Int gccount, last = Int(prev & 3), isrun;
+		Ullong reg;
+		// get GCcount
+		reg = prev & dnaoldmask;
+		reg = (reg ^ (reg >> 1)) & 0x5555555555555555ull; // makes ones for GC, zeros for AT
+		// popcount inline:
+		reg -= ((reg >> 1) & 0x5555555555555555ull);
+		reg = (reg & 0x3333333333333333ull) + (reg >> 2 & 0x3333333333333333ull);
+		gccount = Int(((reg + (reg >> 4)) & 0xf0f0f0f0f0f0f0full) * 0x101010101010101ull >> 56); // the popcount
+		// a run if the last MAXRUN chars all equal the last one
+		isrun = (((prev ^ (Ullong(last) * 0x5555555555555555ull)) & runmask) == 0);
+		const Choice &c = table[(gccount * 2 + isrun) * 4 + last];
+		dnac_ok[0] = c.ok[0];
+		dnac_ok[1] = c.ok[1];
+		dnac_ok[2] = c.ok[2];
+		dnac_ok[3] = c.ok[3];
+		return c.n;
 	}
-	// the horrible logic tree:
+};
+DNAConstraints dnacon;
+GF4reg acgtacgt(0x1b1b1b1b1b1b1b1bllu); // "ACGTACGTACGTACGT" used for initialization
+
+void DNAConstraints::set(Int window, Int maxgc, Int mingc, Int maxrun)
+{
+	Int gccount, isrun, last, nrun = MAX(maxrun, 2); // a run always has two chars, even if MAXRUN < 2
+	DNAWINDOW = window;
+	MAXGC = maxgc;
+	MINGC = mingc;
+	MAXRUN = maxrun;
+	dnawinmask = (Ullong(1) << 2 * DNAWINDOW) - 1;
+	dnaoldmask = (Ullong(1) << 2 * (DNAWINDOW - 1)) - 1;
+	runmask = (nrun >= 32 ? ~Ullong(0) : (Ullong(1) << 2 * nrun) - 1);
+	for (gccount = 0; gccount <= 32; gccount++)
+		for (isrun = 0; isrun < 2; isrun++)
+			for (last = 0; last < 4; last++)
+			{
+				Choice &c = table[(gccount * 2 + isrun) * 4 + last];
+				if (DNAWINDOW <= 0)
+				{ // no constraints
+					c.n = 4;
+					c.ok[0] = 0;
+					c.ok[1] = 1;
+					c.ok[2] = 2;
+					c.ok[3] = 3;
+				}
+				else // the chars beyond the 32 in a register count as A's, so only A can make a longer run
+					c.n = Uchar(choose(gccount, isrun && (MAXRUN <= 32 || last == 0), last, c.ok));
+			}
+}
+
+Int DNAConstraints::choose(Int gccount, bool isrun, Int last, Uchar *dnac_ok) const
+{
+	// the horrible logic tree: returns the number of allowed ACGTs and puts them in dnac_ok
+	Int ans;
+	dnac_ok[0] = dnac_ok[1] = dnac_ok[2] = dnac_ok[3] = 0;
 	if (gccount >= MAXGC)
 	{
 		ans = 2;
@@ -142,11 +183,35 @@ Int dnacallowed(GF4reg prev)
 }
 
 Ranhash ranhash;
+RanhashBatch ranhashbatch; // the same hash, many at a time
+DNAPacker dnapacker;		  // strands at 2 bits per base
+inline Ullong digestkey(Ullong bits, Int seq, Ullong salt)
+{
+	return ((((Ullong(seq) & seqnomask) << NPREV) | bits) << HSALT) | salt;
+}
 inline Int digest(Ullong bits, Int seq, Ullong salt, Int mod)
 {
-	return Int(ranhash.int64(
-				   ((((Ullong(seq) & seqnomask) << NPREV) | bits) << HSALT) | salt) %
-			   mod);
+	return Int(ranhash.int64(digestkey(bits, seq, salt)) % mod);
+}
+
+// search options: these change how fast the decoder finds its answer, not the answer
+Int BUCKETS = 0; // use a bucket queue when dither is off and the scores allow (see HedgesDecoder::scorelattice)
+Int LAZY = 0;	 // queue moves with optimistic scores and build a hypothesis only when its move is popped
+Int STRANDLEN = 0; // if > 0, the length strands were written with: charge early for indels the read's length implies
+Int MERGE = 0;	   // keep only the best of the hypotheses that reach the same state (see HedgesDecoder::merged)
+Int DPBAND = 0;	   // if > 0, decode by dynamic programming, within DPBAND of the diagonal (see HedgesDecoder::bandsearch)
+Int DPKEEP = 16;   // with DPBAND, how many hypotheses to keep for each seq and offset
+Int PRIMERDP = 1;  // align the left primer by dynamic programming and search from its end (see HedgesDecoder::primerfront)
+Int SPECIALIZE = 1; // search with a kernel compiled for the code rate and constraint mode (see HedgesDecoder::searchwith)
+
+const char *searchproblem(Int lazy, Int hlimit, Int dpband, Int dpkeep)
+{ // why a search can't run with these options, or NULL if it can. Checked when they are set, and
+	// by the search itself, which can only refuse (with errcode 3): its worker threads can't report to Python
+	if (lazy && hlimit >= (1 << 27))
+		return "HLIMIT must be below 2^27 with LAZY"; // see cargo in HedgesDecoder::shoveltheheap
+	if (dpband > 0 && dpkeep < 1)
+		return "DPKEEP must be at least 1";
+	return NULL;
 }
 
 static PyObject *getversion(PyObject *self, PyObject *pyargs)
@@ -184,6 +249,12 @@ static PyObject *setparams(PyObject *self, PyObject *pyargs)
 		NRpyException("setparams takes exactly 4 arguments");
 		return NRpyObject(Int(1));
 	}
+	const char *problem = searchproblem(LAZY, NRpyInt(args[3]), DPBAND, DPKEEP);
+	if (problem != NULL)
+	{
+		NRpyException(problem);
+		return NRpyObject(Int(1));
+	}
 	NSALT = NRpyInt(args[0]);
 	MAXSEQ = NRpyInt(args[1]);
 	NSTAK = NRpyInt(args[2]);
@@ -195,23 +266,17 @@ static PyObject *getdnaconstraints(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
 	return NRpyTuple(
-		NRpyObject(DNAWINDOW),
-		NRpyObject(MAXGC),
-		NRpyObject(MINGC),
-		NRpyObject(MAXRUN),
+		NRpyObject(dnacon.DNAWINDOW),
+		NRpyObject(dnacon.MAXGC),
+		NRpyObject(dnacon.MINGC),
+		NRpyObject(dnacon.MAXRUN),
 		NULL);
 }
 
 static PyObject *restorednaconstraints(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
-	DNAWINDOW = 12;
-	MAXGC = 8;
-	MINGC = 4;
-	MAXRUN = 4;
-	dnawinmask = (Ullong(1) << 2 * DNAWINDOW) - 1;
-	dnaoldmask = (Ullong(1) << 2 * (DNAWINDOW - 1)) - 1;
-
+	dnacon.set(12, 8, 4, 4);
 	return NRpyObject(Int(0));
 }
 
@@ -223,12 +288,7 @@ static PyObject *setdnaconstraints(PyObject *self, PyObject *pyargs)
 		NRpyException("setdnaconstraints takes exactly 4 arguments");
 		return NRpyObject(Int(1));
 	}
-	DNAWINDOW = NRpyInt(args[0]);
-	MAXGC = NRpyInt(args[1]);
-	MINGC = NRpyInt(args[2]);
-	MAXRUN = NRpyInt(args[3]);
-	dnawinmask = (Ullong(1) << 2 * DNAWINDOW) - 1;
-	dnaoldmask = (Ullong(1) << 2 * (DNAWINDOW - 1)) - 1;
+	dnacon.set(NRpyInt(args[0]), NRpyInt(args[1]), NRpyInt(args[2]), NRpyInt(args[3]));
 	return NRpyObject(Int(0));
 }
 
@@ -238,6 +298,29 @@ Doub substitution = 1.;
 Doub deletion = 1.;
 Doub insertion = 1.;
 Doub dither = 0.;
+Doub qualityref = 20.; // Phred score at and above which a base gets the full reward or substitution
+
+VecDoub qualityweights(Doub qref)
+{
+	// with per-base quality, the reward or substitution at a base of Phred score q is scaled by
+	// w[q] = (log-likelihood ratio of a match to a mismatch at q) / (the same at qref), at most 1.
+	// A call with error probability e >= 3/4 says nothing, so w = 0 there.
+	Int q;
+	Doub e, llr, llrref;
+	VecDoub w(256, 1.); // any byte may be a quality; those above 93 (the FASTQ maximum) count as 93
+	e = MIN(pow(10., -qref / 10.), 0.75);
+	llrref = log(3. * (1. - e) / e);
+	if (llrref <= 0.)
+		return w; // no meaningful reference: ignore quality
+	for (q = 0; q < 256; q++)
+	{
+		e = MIN(pow(10., -MIN(q, 93) / 10.), 0.75);
+		llr = log(3. * (1. - e) / e);
+		w[q] = MIN(1., llr / llrref);
+	}
+	return w;
+}
+VecDoub qualityweight = qualityweights(qualityref);
 
 static PyObject *getscores(PyObject *self, PyObject *pyargs)
 {
@@ -248,6 +331,7 @@ static PyObject *getscores(PyObject *self, PyObject *pyargs)
 		NRpyObject(deletion),
 		NRpyObject(insertion),
 		NRpyObject(dither),
+		NRpyObject(qualityref),
 		NULL);
 }
 
@@ -259,15 +343,17 @@ static PyObject *restorescores(PyObject *self, PyObject *pyargs)
 	deletion = 1.;
 	insertion = 1.;
 	dither = 0.;
+	qualityref = 20.;
+	qualityweight = qualityweights(qualityref);
 	return NRpyObject(Int(0));
 }
 
 static PyObject *setscores(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
-	if (args.size() != 5)
+	if (args.size() < 5 || args.size() > 6)
 	{
-		NRpyException("setscores takes exactly 5 arguments");
+		NRpyException("setscores takes 5 or 6 arguments");
 		return NRpyObject(Int(1));
 	}
 	reward = NRpyDoub(args[0]);
@@ -275,64 +361,132 @@ static PyObject *setscores(PyObject *self, PyObject *pyargs)
 	deletion = NRpyDoub(args[2]);
 	insertion = NRpyDoub(args[3]);
 	dither = NRpyDoub(args[4]);
+	if (args.size() > 5)
+	{
+		qualityref = NRpyDoub(args[5]);
+		qualityweight = qualityweights(qualityref);
+	}
+	return NRpyObject(Int(0));
+}
+
+static PyObject *getsearchoptions(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	return NRpyTuple(
+		NRpyObject(BUCKETS),
+		NRpyObject(LAZY),
+		NRpyObject(STRANDLEN),
+		NRpyObject(MERGE),
+		NRpyObject(DPBAND),
+		NRpyObject(DPKEEP),
+		NRpyObject(PRIMERDP),
+		NRpyObject(SPECIALIZE),
+		NULL);
+}
+
+static PyObject *restoresearchoptions(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	BUCKETS = 0;
+	LAZY = 0;
+	STRANDLEN = 0;
+	MERGE = 0;
+	DPBAND = 0;
+	DPKEEP = 16;
+	PRIMERDP = 1;
+	SPECIALIZE = 1;
+	return NRpyObject(Int(0));
+}
+
+static PyObject *setsearchoptions(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 8)
+	{
+		NRpyException("setsearchoptions takes exactly 8 arguments");
+		return NRpyObject(Int(1));
+	}
+	const char *problem = searchproblem(NRpyInt(args[1]), HLIMIT, NRpyInt(args[4]), NRpyInt(args[5]));
+	if (problem != NULL)
+	{
+		NRpyException(problem);
+		return NRpyObject(Int(1));
+	}
+	BUCKETS = NRpyInt(args[0]);
+	LAZY = NRpyInt(args[1]);
+	STRANDLEN = NRpyInt(args[2]);
+	MERGE = NRpyInt(args[3]);
+	DPBAND = NRpyInt(args[4]);
+	DPKEEP = NRpyInt(args[5]);
+	PRIMERDP = NRpyInt(args[6]);
+	SPECIALIZE = NRpyInt(args[7]);
 	return NRpyObject(Int(0));
 }
 
 // more globals
-Ran ran;			 // (11015);
-GF4char *codetext_g; // set in decode, used by init_from_predecessor
-Int codetextlen_g;	 // ditto
-Int nhypo = 0;
-HeapScheduler<Doub, Int> heap;
-Int errcode = 0;
-Int nfinal, nnstak;
-Doub finalscore;
-Int finaloffset, finalseq;
+Ullong RANSEED = 0; // 0 seeds from the clock; else set by setseed(), making every random number reproducible
+Ran ran;			// (11015); used by createerrors (each decoder context has its own for dither)
 
-void findprimersalt(const char *leftpr, const char *rightpr)
-{ // set salt to match a leftprimer
+void findprimersalt(const char *leftpr, const char *rightpr, GF4word &left, GF4word &right, VecUllong &salt)
+{ // salt to match a leftprimer
 	Int regout, i, k, np = Int(strlen(leftpr)), mp = Int(strlen(rightpr));
 	char ACGT[] = "ACGTacgt";
 	VecInt ACGTvalue(256, 0);
-	LPRIMER = np;
-	RPRIMER = mp;
-	leftprimer.resize(np);
-	primersalt.resize(np);
-	rightprimer.resize(mp);
+	left.resize(np);
+	salt.resize(np);
+	right.resize(mp);
 	for (i = 0; i < 8; i++)
 		ACGTvalue[ACGT[i]] = i % 4;
 	for (k = 0; k < np; k++)
-		leftprimer[k] = ACGTvalue[leftpr[k]];
+		left[k] = ACGTvalue[leftpr[k]];
 	for (k = 0; k < mp; k++)
-		rightprimer[k] = ACGTvalue[rightpr[k]];
+		right[k] = ACGTvalue[rightpr[k]];
 	for (k = 0; k < np; k++)
 	{
 		for (i = 0; i < 100; i++)
 		{ // try up to 100 times
 			regout = digest(Ullong(0), k, Ullong(i), 4);
-			if (regout == leftprimer[k])
+			if (regout == left[k])
 			{
-				primersalt[k] = i;
+				salt[k] = i;
 				break;
 			}
 		}
 	}
 }
 
-Int vbitlen(Int nmb)
+void findprimersalt(const char *leftpr, const char *rightpr)
+{ // set the global primers and salt
+	findprimersalt(leftpr, rightpr, leftprimer, rightprimer, primersalt);
+	LPRIMER = leftprimer.size();
+	RPRIMER = rightprimer.size();
+}
+
+Int vbitlen(Int nmb, const VecInt &patt = pattarr, Int maxseq = MAXSEQ)
 { // how long is message in vbits?  (patarr must already be set)
 	Int ksize, nn = 0;
 	for (ksize = 0;; ksize++)
 	{ // how many Mbits do we need?
 		if (nn >= nmb)
 			break;
-		if (ksize >= MAXSEQ)
+		if (ksize >= maxseq)
+		{
 			NRpyException("vbitlen: MAXSEQ too small");
-		nn += pattarr[ksize];
+			break;
+		}
+		nn += patt[ksize];
 	}
 	return ksize;
 }
 
+Int maxmessbits(const VecInt &patt = pattarr, Int maxseq = MAXSEQ)
+{ // the most message bits that vbitlen can fit in maxseq vbits: a check that reports nothing to Python
+	Int k, nn = 0;
+	for (k = 0; k < maxseq; k++)
+		nn += patt[k];
+	return nn;
+}
+
 static PyObject *minstrandlen(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
@@ -341,8 +495,6 @@ static PyObject *minstrandlen(PyObject *self, PyObject *pyargs)
 	return NRpyObject(len);
 }
 
-// one more global below (hypostack)
-
 static PyObject *hashint(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
@@ -356,58 +508,96 @@ static PyObject *hashint(PyObject *self, PyObject *pyargs)
 	return NRpyObject(hash);
 }
 
-void setcoderate_C(Int pattnumber, const char *leftpr, const char *rightpr)
-{ // some standard patterns
-	findprimersalt(leftpr, rightpr);
+void standardpattern(Int pattnumber, VecUchar &patt, Doub &rew)
+{ // some standard patterns, each with the reward that suits it (patt and rew unchanged if no such pattern)
 	if (pattnumber == 1)
 	{ // rate 0.75
-		pattrn.resize(2);
-		pattrn[0] = 2;
-		pattrn[1] = 1;
-		reward = -0.035;
+		patt.resize(2);
+		patt[0] = 2;
+		patt[1] = 1;
+		rew = -0.035;
 	}
 	if (pattnumber == 2)
 	{ // rate 0.6
-		pattrn.resize(5);
-		pattrn[0] = 2;
-		pattrn[1] = pattrn[2] = pattrn[3] = pattrn[4] = 1;
-		reward = -0.082;
+		patt.resize(5);
+		patt[0] = 2;
+		patt[1] = patt[2] = patt[3] = patt[4] = 1;
+		rew = -0.082;
 	}
 	if (pattnumber == 3)
 	{ // rate 0.5
-		pattrn.resize(1);
-		pattrn[0] = 1;
-		reward = -0.127;
+		patt.resize(1);
+		patt[0] = 1;
+		rew = -0.127;
 	}
 	if (pattnumber == 4)
 	{ // rate 0.333
-		pattrn.resize(3);
-		pattrn[0] = pattrn[1] = 1;
-		pattrn[2] = 0;
-		reward = -0.229;
+		patt.resize(3);
+		patt[0] = patt[1] = 1;
+		patt[2] = 0;
+		rew = -0.229;
 	}
 	if (pattnumber == 5)
 	{ // rate 0.25
-		pattrn.resize(2);
-		pattrn[0] = 1;
-		pattrn[1] = 0;
-		reward = -0.265;
+		patt.resize(2);
+		patt[0] = 1;
+		patt[1] = 0;
+		rew = -0.265;
 	}
 	if (pattnumber == 6)
 	{ // rate 0.166
-		pattrn.resize(3);
-		pattrn[0] = 1;
-		pattrn[1] = pattrn[2] = 0;
-		reward = -0.324;
+		patt.resize(3);
+		patt[0] = 1;
+		patt[1] = patt[2] = 0;
+		rew = -0.324;
 	}
-	pattarr.assign(MAXSEQ + 2, 1);
+}
+
+void fillpattarr(VecInt &patt, const VecUchar &pattern, Int lprimer, Int maxseq)
+{ // pattern repeated over the vbits after the primer
+	patt.assign(maxseq + 2, 1);
+	for (int i = 0; i < maxseq; i++)
+		patt[i] = (i < lprimer ? 0 : pattern[i % pattern.size()]);
+}
+
+Int standardnumber(const VecUchar &patt)
+{ // the standard pattern that patt is, or 0 if none
+	Int i, pattnumber;
+	Doub rew = 0.;
+	VecUchar std;
+	for (pattnumber = 1; pattnumber <= 6; pattnumber++)
+	{
+		standardpattern(pattnumber, std, rew);
+		if (std.size() != patt.size())
+			continue;
+		for (i = 0; i < patt.size() && patt[i] == std[i]; i++)
+			;
+		if (i == patt.size())
+			return pattnumber;
+	}
+	return 0;
+}
+
+void setpattern_C(const VecUchar &patt, Doub rew, const char *leftpr, const char *rightpr)
+{ // any pattern of 0, 1, or 2 bits per vbit, with its reward
+	findprimersalt(leftpr, rightpr);
+	pattrn = patt;
+	reward = rew;
+	PATTERN = standardnumber(pattrn); // 0 (no specialized kernel) for a pattern of one's own
 	npattrn = pattrn.size();
-	for (int i = 0; i < MAXSEQ; i++)
-		pattarr[i] = (i < LPRIMER ? 0 : pattrn[i % npattrn]);
+	fillpattarr(pattarr, pattrn, LPRIMER, MAXSEQ);
 	VSALT = vbitlen(NSALT);
 	NSP = VSALT + LPRIMER;
 }
 
+void setcoderate_C(Int pattnumber, const char *leftpr, const char *rightpr)
+{
+	VecUchar patt(pattrn);
+	Doub rew = reward;
+	standardpattern(pattnumber, patt, rew);
+	setpattern_C(patt, rew, leftpr, rightpr);
+}
+
 static PyObject *setcoderate(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
@@ -429,12 +619,12 @@ static PyObject *setcoderate(PyObject *self, PyObject *pyargs)
 	return NRpyObject(Int(0));
 }
 
-VecMbit unpackvbits(const char *message, Int n, Int len)
-{
+void unpackvbits(const char *message, Int n, Int len, vector<Mbit> &ans)
+{ // into ans, which is not an NRvector so that encode_batch's threads can call this without the GIL
 	Int i, j, nmb = 8 * n, k, k1, ksize;
 	Uchar bit;
 	ksize = MAX(vbitlen(nmb), len - RPRIMER); // aim for codetext of length len if possible
-	VecMbit ans(ksize, Uchar(0));
+	ans.assign(ksize, Uchar(0));
 	i = j = 0;
 	for (k = 0; k < ksize; k++)
 	{
@@ -449,24 +639,23 @@ VecMbit unpackvbits(const char *message, Int n, Int len)
 			ans[k] = (ans[k] << 1) | bit;
 		}
 	}
-	return ans;
 }
 
-VecUchar packvbits(VecMbit &vbits, Int nmessbits)
-{
-	Int i, j, k, k1, ksize = vbits.size(), nn = 0;
+void packvbits(const vector<Mbit> &vbits, Int nmessbits, const VecInt &patt, Int maxseq, vector<Uchar> &ans)
+{ // into ans: decoders call this in threads without the GIL (see HedgesDecoder)
+	Int i, j, k, k1, ksize = MIN(Int(vbits.size()), maxseq), nn = 0; // (no search goes past maxseq)
 	Uchar bit;
-	if (ksize > MAXSEQ)
-		throw("packvbits: MAXSEQ too small");
 	for (k = 0; k < ksize; k++)
-		nn += pattarr[k];	 // number of bits
+		nn += patt[k];		 // number of bits
 	nn = MIN(nn, nmessbits); // no more than the specified number of bits
 	nn = (nn + 7) / 8;		 // number of bytes
-	VecUchar ans(nn, Uchar(0));
+	ans.assign(nn, Uchar(0));
+	if (nn == 0)
+		return; // as when nmessbits is 0 (else, with no left primer, ans[0] below is out of bounds)
 	i = j = 0;
 	for (k = 0; k < ksize; k++)
 	{
-		for (k1 = pattarr[k] - 1; k1 >= 0; k1--)
+		for (k1 = patt[k] - 1; k1 >= 0; k1--)
 		{
 			bit = (vbits[k] >> k1) & 1;
 			ans[i] = ans[i] | (bit << (7 - j++));
@@ -480,7 +669,6 @@ VecUchar packvbits(VecMbit &vbits, Int nmessbits)
 		if (i == nn)
 			break;
 	}
-	return ans;
 }
 
 Int bytepopcount(Uchar byte)
@@ -491,15 +679,12 @@ Int bytepopcount(Uchar byte)
 	return NIBBLE_LOOKUP[byte & 0x0F] + NIBBLE_LOOKUP[byte >> 4];
 }
 
-GF4word encode_C(const char *message, Int n, Int len = 0)
-{ // dnac
+void encodevbits_C(const vector<Mbit> &vbits, GF4char *codetext)
+{ // dnac; the codetext of vbits, less the right primer, into codetext[0..vbits.size()-1]
 	Int regout;
-	GF4word vbits = unpackvbits(message, n, len);
-	Int k = 0, nbits, mod, nm = vbits.size(); // number of variable bits encoded
-	if (nm > MAXSEQ)
-		throw("encode: MAXSEQ too small");
-	GF4word codetext(nm + RPRIMER);
+	Int k = 0, nbits, mod, nm = Int(vbits.size()); // number of variable bits encoded
 	Mbit messagebit;
+	Uchar dnac_ok[4];
 	Ullong prevbits = 0, salt = 0, newsalt = 0;
 	GF4reg prevcode = acgtacgt; // initialize with no runs and balanced cg
 	for (k = 0; k < nm; k++)
@@ -519,13 +704,26 @@ GF4word encode_C(const char *message, Int n, Int len = 0)
 		{
 			salt = newsalt; // time to update the salt
 		}
-		mod = (k < LPRIMER ? 4 : dnacallowed(prevcode));
+		mod = (k < LPRIMER ? 4 : dnacon.allowed(prevcode, dnac_ok));
 		regout = digest(prevbits, k, salt, mod);
 		regout = (regout + Uchar(messagebit)) % mod;
 		codetext[k] = (k < LPRIMER ? regout : dnac_ok[regout]);
 		prevbits = ((prevbits << nbits) & prevmask) | messagebit; // variable number
-		prevcode = ((prevcode << 2) | codetext[k]) & dnawinmask;
+		prevcode = ((prevcode << 2) | codetext[k]) & dnacon.dnawinmask;
 	}
+}
+
+GF4word encode_C(const char *message, Int n, Int len = 0)
+{
+	Int k, nm;
+	vector<Mbit> vbits;
+	unpackvbits(message, n, len, vbits);
+	nm = Int(vbits.size());
+	if (nm > MAXSEQ)
+		throw("encode: MAXSEQ too small");
+	GF4word codetext(nm + RPRIMER);
+	if (nm > 0)
+		encodevbits_C(vbits, &codetext[0]);
 	for (k = 0; k < RPRIMER; k++)
 	{
 		codetext[k + nm] = rightprimer[k];
@@ -577,333 +775,2106 @@ static PyObject *encodestring(PyObject *self, PyObject *pyargs)
 	return NRpyObject(codetext);
 }
 
-struct Hypothesis;				  // forward declaration for next line
-NRvector<Hypothesis> *hypostackp; // pointed to hypostack by init_heap_and_stack()
-
-struct Hypothesis
-{
-	Int predi;		 // index of predecessor in hypostackp
-	Int offset;		 // next char in message
-	Int seq;		 // my position in the decoded message (0,1,...)
-	Doub score;		 // my -logprob score before update
-	Mbit messagebit; // last decoded up to now
-	Ullong prevbits, salt, newsalt;
-	GF4reg prevcode;
-
-	Hypothesis() {}
-	Hypothesis(int) {} // so that can cast from zero in NRvector constructor
-
-	Int init_from_predecessor(Int pred, Mbit mbit, Int skew)
-	{
-		bool discrep;
-		Int regout, mod;
-		Doub mypenalty;
-		Ullong mysalt;
-		Hypothesis *hp = &(*hypostackp)[pred]; // temp pointer to predecessor
-		predi = pred;
-		messagebit = mbit; // variable number
-		seq = hp->seq + 1;
-		if (seq > MAXSEQ)
-			throw("init_from_predecessor: MAXSEQ too small");
-		Int nbits = pattarr[seq];
-		prevbits = hp->prevbits;
-		salt = hp->salt;
-		if (seq < LPRIMER)
-		{
-			mysalt = primersalt[seq];
-		}
-		else if (seq < NSP)
-		{
-			mysalt = salt;
-			newsalt = ((hp->newsalt << 1) & saltmask) ^ messagebit; // variable bits overlap, but that's ok with XOR
-		}
-		else if (seq == NSP)
-		{
-			mysalt = salt = hp->newsalt; // time to update the salt
-		}
-		else
-			mysalt = salt;
-		offset = hp->offset + 1 + skew;
-		if (offset >= codetextlen_g)
-			return 0; // i.e., false
-		// calculate predicted message under this hypothesis
-		prevcode = hp->prevcode;
-		mod = (seq < LPRIMER ? 4 : dnacallowed(prevcode));
-		regout = digest(prevbits, seq, mysalt, mod);
-		regout = (regout + Uchar(messagebit)) % mod;
-		regout = (seq < LPRIMER ? regout : dnac_ok[regout]);
-		prevbits = ((hp->prevbits << nbits) & prevmask) | messagebit; // variable number
-		prevcode = ((prevcode << 2) | regout) & dnawinmask;
-		// compare to observed message and score
-		if (skew < 0)
-		{ // deletion
-			mypenalty = deletion;
-		}
-		else
+static PyObject *encode_packed(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int len = 0;
+	if (args.size() < 1 || args.size() > 2)
+	{
+		NRpyException("encode_packed takes 1 or 2 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("encode_packed requires array with dtype=uint8 \n");
+	VecUchar message(args[0]);
+	if (args.size() > 1)
+		len = NRpyInt(args[1]);
+	GF4word codetext = encode_C(message, len);
+	VecUchar packed(MAX(1, DNAPacker::nbytes(codetext.size())), Uchar(0));
+	if (codetext.size() > 0)
+		dnapacker.pack(&codetext[0], &packed[0], codetext.size());
+	return NRpyTuple(
+		NRpyObject(packed),
+		NRpyObject(Int(codetext.size())),
+		NULL);
+}
+
+Int defaultnthreads(Int nthreads, Int njobs)
+{ // nthreads <= 0 means one per hardware thread; never more threads than jobs
+	if (nthreads <= 0)
+		nthreads = Int(thread::hardware_concurrency());
+	return MAX(1, MIN(nthreads, njobs));
+}
+
+void encodefilled_C(const char *message, Int n, Int totstrandlen, VecUchar &filler, GF4char *dna)
+{
+	// encode into dna[0..totstrandlen-1], with filler (as much as needed) spliced in
+	// between the encoded message and the right primer; any remainder is zeroed.
+	// N.B. the filler can violate the output constraints (very slightly at end of strand)
+	// The caller checks that the message fits (encode_batch's threads can't report errors).
+	Int k, m, nm, nfill;
+	vector<Mbit> vbits;
+	unpackvbits(message, n, 0, vbits);
+	nm = m = Int(vbits.size());
+	if (nm > 0)
+		encodevbits_C(vbits, dna);
+	nfill = MIN(totstrandlen - nm - RPRIMER, filler.size());
+	for (k = 0; k < nfill; k++)
+		dna[m++] = filler[k];
+	for (k = 0; k < RPRIMER; k++)
+		dna[m++] = rightprimer[k];
+	while (m < totstrandlen)
+		dna[m++] = 0;
+}
+
+struct EncodeBatch
+{
+	// encode every row of a message matrix into a row of a DNA matrix, in parallel.
+	// Encoding only reads the global settings, so the workers need no contexts.
+	MatUchar &messages, &dna;
+	VecUchar &filler;
+	Int nrows, totstrandlen; // with totstrandlen > 0, rows of dna are packed, totstrandlen bases each
+	atomic<Int> nextrow;
+
+	EncodeBatch(MatUchar &messagesin, MatUchar &dnain, VecUchar &fillerin, Int totstrandlenin = 0) : messages(messagesin),
+		dna(dnain), filler(fillerin), nrows(messagesin.nrows()), totstrandlen(totstrandlenin), nextrow(0) {}
+	void work()
+	{ // (without the GIL, so no NRvectors: see HedgesDecoder)
+		Int i;
+		vector<GF4char> strand(MAX(1, totstrandlen)); // this worker's, for packing from
+		while ((i = nextrow++) < nrows)
 		{
-			discrep = (regout == codetext_g[offset]); // the only place where a check is possible!
-			if (skew == 0)
-				mypenalty = (discrep ? reward : substitution);
-			else
-			{ // insertion
-				mypenalty = insertion + (discrep ? reward : substitution);
+			if (totstrandlen > 0)
+			{
+				encodefilled_C((char *)messages[i], messages.ncols(), totstrandlen, filler, &strand[0]);
+				dnapacker.pack(&strand[0], dna[i], totstrandlen);
 			}
+			else
+				encodefilled_C((char *)messages[i], messages.ncols(), dna.ncols(), filler, dna[i]);
 		}
-		if (dither > 0.)
-			mypenalty += dither * (2. * ran.doub() - 1.);
-		score = hp->score + mypenalty;
-		return 1; // i.e., true
-	}
-	void init_root()
-	{
-		predi = -1;
-		offset = -1;
-		seq = -1;
-		messagebit = 0; // not really a message bit
-		prevbits = 0;
-		score = 0.;
-		salt = 0;
-		newsalt = 0;
-		prevcode = acgtacgt;
-	}
-	Int myid() { return Int(this - &((*hypostackp)[0])); } // my index in hypostack
+	}
+	void run(Int nthreads)
+	{
+		Int t;
+		vector<thread> workers;
+		Py_BEGIN_ALLOW_THREADS;
+		for (t = 1; t < nthreads; t++)
+			workers.push_back(thread(&EncodeBatch::work, this));
+		work(); // the calling thread is worker 0
+		for (t = 0; t < Int(workers.size()); t++)
+			workers[t].join();
+		Py_END_ALLOW_THREADS;
+	}
 };
 
-// final global
-NRvector<Hypothesis> hypostack;
-
-void release()
-{ // give back heap and hypostack memory
-	heap.reinit();
-	hypostack.resize(NSTAK, false);
+static PyObject *encode_batch(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nthreads = 0;
+	if (args.size() < 3 || args.size() > 5)
+	{
+		NRpyException("encode_batch takes 3 to 5 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE || PyArray_TYPE(args[2]) != PyArray_UBYTE)
+		NRpyException("encode_batch requires arrays with dtype=uint8 \n");
+	MatUchar messages(args[0]);
+	Int totstrandlen = NRpyInt(args[1]);
+	VecUchar filler(args[2]);
+	MatUchar dna;
+	if (args.size() > 3 && args[3] != Py_None)
+	{ // write into the caller's matrix
+		if (PyArray_TYPE(args[3]) != PyArray_UBYTE)
+			NRpyException("encode_batch requires array with dtype=uint8 \n");
+		dna.initpymat(args[3]);
+	}
+	if (args.size() > 4)
+		nthreads = NRpyInt(args[4]);
+	// checked here, because the worker threads can't report errors to Python
+	if (8 * messages.ncols() > maxmessbits())
+	{ // (before vbitlen, which would report it)
+		NRpyException("encode_batch: MAXSEQ too small for messages");
+		return NRpyObject(0);
+	}
+	if (vbitlen(8 * messages.ncols()) + RPRIMER > totstrandlen)
+	{
+		NRpyException("encode_batch: totstrandlen too small for messages");
+		return NRpyObject(0);
+	}
+	if (dna.ownsdata)
+		dna.assign(messages.nrows(), totstrandlen, Uchar(0));
+	else if (dna.nrows() != messages.nrows() || dna.ncols() != totstrandlen)
+	{
+		NRpyException("encode_batch: output matrix must be [nstrands, totstrandlen]");
+		return NRpyObject(0);
+	}
+	EncodeBatch batch(messages, dna, filler);
+	batch.run(defaultnthreads(nthreads, batch.nrows));
+	return NRpyObject(dna);
 }
 
-void init_heap_and_stack()
+static PyObject *encode_batch_packed(PyObject *self, PyObject *pyargs)
 {
-	hypostackp = &hypostack;
-	if (nnstak < NSTAK)
+	NRpyArgs args(pyargs);
+	Int nthreads = 0;
+	if (args.size() < 3 || args.size() > 4)
+	{
+		NRpyException("encode_batch_packed takes 3 or 4 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE || PyArray_TYPE(args[2]) != PyArray_UBYTE)
+		NRpyException("encode_batch_packed requires arrays with dtype=uint8 \n");
+	MatUchar messages(args[0]);
+	Int totstrandlen = NRpyInt(args[1]);
+	VecUchar filler(args[2]);
+	if (args.size() > 3)
+		nthreads = NRpyInt(args[3]);
+	if (8 * messages.ncols() > maxmessbits())
+	{ // checked here, because the worker threads can't report errors to Python (and before vbitlen, which would)
+		NRpyException("encode_batch_packed: MAXSEQ too small for messages");
+		return NRpyObject(0);
+	}
+	if (totstrandlen < 1 || vbitlen(8 * messages.ncols()) + RPRIMER > totstrandlen)
 	{
-		nnstak = NSTAK;
-		hypostack.resize(NSTAK, false);
+		NRpyException("encode_batch_packed: totstrandlen too small for messages");
+		return NRpyObject(0);
 	}
-	hypostack[0].init_root();
-	nhypo = 1;
-	heap.rewind();
-	heap.push(1.e10, 0);
+	MatUchar dna(messages.nrows(), DNAPacker::nbytes(totstrandlen), Uchar(0));
+	EncodeBatch batch(messages, dna, filler, totstrandlen);
+	batch.run(defaultnthreads(nthreads, batch.nrows));
+	return NRpyObject(dna);
 }
 
-void shoveltheheap(Int limit, Int nmessbits)
+// the priority queues of hypotheses: any scheduler with the HeapScheduler interface will do
+typedef DaryHeapScheduler<Doub, Int, 4> HypoScheduler; // general
+typedef BucketScheduler<Int> HypoBuckets;				// when scores lie on a lattice
+
+struct HedgesDecoder; // forward declaration for next struct
+
+// Hypotheses are stored column-wise, one array per field, in fixed-size chunks that are
+// allocated as needed and never moved, so growing the store never copies it.
+// A hypothesis costs 31 bytes: salt and newsalt share a field, since newsalt is only
+// needed while seq < NSP and salt only after, and scores are single precision.
+// One of the 31 is dropped, which is only meaningful with MERGE.
+// In a joint decode of several reads, offset is that in the first read, and the others'
+// are kept alongside in chunks of their own (see setnother).
+struct HypoStore
 {
-	// given the heap, keep processing it until offset limit, hypothesis limit, or an error is reached
-	Int qq, seq, nguess, qqmax = -1, ofmax = -1, seqmax = vbitlen(nmessbits);
-	Uchar mbit;
-	Doub currscore;
-	Hypothesis *hp = NULL;
-	errcode = 0;
-	while (true)
+	static const Int CHUNKBITS = 16;
+	static const Int CHUNKSIZE = 1 << CHUNKBITS;
+	static const Int CHUNKMASK = CHUNKSIZE - 1;
+	struct Chunk
 	{
-		currscore = heap.pop(qq);
-		hp = &hypostack[qq];
-		seq = hp->seq;
-		if (seq > MAXSEQ)
-			NRpyException("shoveltheheap: MAXSEQ too small");
-		nguess = 1 << pattarr[seq + 1]; // i.e., 1, 2, or 4
-		if (hp->offset > ofmax)
-		{ // keep track of farthest gotten to
-			ofmax = hp->offset;
-			qqmax = qq;
-		}
-		if (currscore > 1.e10)
-			break; // heap is empty
-		if (hp->offset >= limit - 1)
-			break; // errcode 0 (nominal success)
-		if (nmessbits > 0 && seq >= seqmax - 1)
-			break; // ditto when no. of message bits specified
-		if (nhypo > HLIMIT)
-		{
-			errcode = 2;
-			nfinal = qqmax;
+		Int predi[CHUNKSIZE];		// index of predecessor in the store
+		Int offset[CHUNKSIZE];		// next char in message
+		Int seq[CHUNKSIZE];			// my position in the decoded message (0,1,...)
+		float score[CHUNKSIZE];		// my -logprob score before update
+		Uint salt[CHUNKSIZE];		// newsalt while seq < NSP, salt thereafter (HSALT <= 32)
+		GF4reg prevcode[CHUNKSIZE];
+		Uchar prevbits[CHUNKSIZE];	// (NPREV <= 8)
+		Mbit messagebit[CHUNKSIZE]; // last decoded up to now
+		Uchar dropped[CHUNKSIZE];	// with MERGE, superseded by a better one in the same state
+	};
+	vector<Chunk *> chunks;
+	vector<Int *> others; // per chunk, nother offsets for each hypothesis, or NULL
+	Int nother;				// reads beyond the first in a joint decode (0 for one read)
+
+	HypoStore() : chunks(0), others(0), nother(0) {}
+	~HypoStore() { release(0); }
+	Int capacity() const { return Int(chunks.size()) << CHUNKBITS; }
+	void reserve(Int n)
+	{ // make room for at least n hypotheses, keeping the ones already stored
+		Int i, nc = Int(chunks.size()), ncnew = (n + CHUNKMASK) >> CHUNKBITS;
+		if (ncnew <= nc)
 			return;
-		}
-		if (nhypo + 12 >= nnstak)
-		{
-			nnstak *= 2;
-			hypostack.resize(nnstak, true);
-			if (hypostack.size() != nnstak)
-				NRpyException("resize of hypostack failed");
-		}
-		for (mbit = 0; mbit < nguess; mbit++)
+		chunks.resize(ncnew);
+		others.resize(ncnew);
+		for (i = nc; i < ncnew; i++)
 		{
-			if (hypostack[nhypo].init_from_predecessor(qq, mbit, 0))
-			{ // substitution
-				heap.push(hypostack[nhypo].score, nhypo);
-				nhypo++;
-			}
+			chunks[i] = new Chunk;
+			others[i] = (nother > 0 ? new Int[CHUNKSIZE * nother] : NULL);
 		}
-		for (mbit = 0; mbit < nguess; mbit++)
+	}
+	void release(Int n)
+	{ // give back all chunks not needed to hold n hypotheses
+		Int i, nc = Int(chunks.size()), ncnew = (n + CHUNKMASK) >> CHUNKBITS;
+		if (ncnew >= nc)
+			return;
+		for (i = ncnew; i < nc; i++)
 		{
-			if (hypostack[nhypo].init_from_predecessor(qq, mbit, -1))
-			{ // deletion
-				heap.push(hypostack[nhypo].score, nhypo);
-				nhypo++;
-			}
+			delete chunks[i];
+			delete[] others[i];
 		}
-		for (mbit = 0; mbit < nguess; mbit++)
+		chunks.resize(ncnew);
+		others.resize(ncnew);
+	}
+	void setnother(Int n)
+	{ // size the other reads' offsets for a decode of n+1 reads; the hypotheses themselves are not kept
+		Int i;
+		if (n == nother)
+			return;
+		nother = n;
+		for (i = 0; i < Int(others.size()); i++)
 		{
-			if (hypostack[nhypo].init_from_predecessor(qq, mbit, 1))
-			{ // insertion
-				heap.push(hypostack[nhypo].score, nhypo);
-				nhypo++;
-			}
+			delete[] others[i];
+			others[i] = (nother > 0 ? new Int[CHUNKSIZE * nother] : NULL);
 		}
 	}
-	nfinal = qq; // final position
-}
+	inline Chunk &chunk(Int i) { return *chunks[i >> CHUNKBITS]; }
+	inline Int &predi(Int i) { return chunk(i).predi[i & CHUNKMASK]; }
+	inline Int &offset(Int i) { return chunk(i).offset[i & CHUNKMASK]; }
+	inline Int &seq(Int i) { return chunk(i).seq[i & CHUNKMASK]; }
+	inline float &score(Int i) { return chunk(i).score[i & CHUNKMASK]; }
+	inline Uint &salt(Int i) { return chunk(i).salt[i & CHUNKMASK]; }
+	inline GF4reg &prevcode(Int i) { return chunk(i).prevcode[i & CHUNKMASK]; }
+	inline Uchar &prevbits(Int i) { return chunk(i).prevbits[i & CHUNKMASK]; }
+	inline Mbit &messagebit(Int i) { return chunk(i).messagebit[i & CHUNKMASK]; }
+	inline Uchar &dropped(Int i) { return chunk(i).dropped[i & CHUNKMASK]; }
+	inline Int *otheroffsets(Int i) { return others[i >> CHUNKBITS] + (i & CHUNKMASK) * nother; }
+
+private:
+	HypoStore(const HypoStore &);			 // chunks are owned, so no copying
+	HypoStore &operator=(const HypoStore &); // ditto
+};
 
-VecMbit traceback()
+// Transposition table for MERGE: maps a hash of a hypothesis's state to the best hypothesis
+// found so far in that state.  It is a fixed-size cache, in sets of 4 entries (one cache line),
+// and a new state evicts an old one when its set is full: forgetting a state only costs a
+// missed merge.  Each entry carries the stamp of the decode that made it, so clear() is O(1).
+struct StateTable
 {
-	Int k, kk = 0, q = nfinal;
-	while ((q = hypostack[q].predi) > 0)
-		++kk;			 // get length of chain
-	VecMbit ans(kk + 1); // each with variable bits
-	finalscore = hypostack[nfinal].score;
-	finaloffset = hypostack[nfinal].offset;
-	finalseq = hypostack[nfinal].seq;
-	q = nfinal;
-	k = kk;
-	ans[k--] = hypostack[q].messagebit;
-	while ((q = hypostack[q].predi) > 0)
+	static const Int nsets = 1 << 12; // 4 entries of 16 bytes each, so 256 KB: stays in cache
+	struct Entry
 	{
-		ans[k] = hypostack[q].messagebit;
-		--k;
-	}
-	return ans;
-}
-
-// global containers for fulldata
-VecInt allseq;
-VecInt allnhypo;
-VecInt alloffset;
-VecDoub allscore;
-VecInt allpredi;
-VecUchar allmessagebit;
-VecInt allprevbits;
-VecInt allsalt;
-VecInt allnewsalt;
+		Ullong hash;
+		Int index; // in the hypothesis store
+		Int stamp;
+	};
+	vector<Entry> tab;
+	Int stamp;
 
-void traceback_fulldata(NRvector<Hypothesis> &hypostack)
-{
-	// TODO: questionable! messagebit might be 0, 1 or 2 bits.  how are you supposed to know?
-	// see packvbits()
-	Int k, kk = 0, q = nfinal;
-	while ((q = hypostack[q].predi) > 0)
-		++kk; // get length of chain
-	finalscore = hypostack[nfinal].score;
-	finaloffset = hypostack[nfinal].offset;
-	finalseq = hypostack[nfinal].seq;
-	allseq.resize(kk + 1);
-	alloffset.resize(kk + 1);
-	allscore.resize(kk + 1);
-	allnhypo.resize(kk + 1);
-	allpredi.resize(kk + 1);
-	allmessagebit.resize(kk + 1);
-	allprevbits.resize(kk + 1);
-	allsalt.resize(kk + 1);
-	allnewsalt.resize(kk + 1);
-	finalscore = hypostack[nfinal].score;
-	finaloffset = hypostack[nfinal].offset;
-	finalseq = hypostack[nfinal].seq;
-	q = nfinal;
-	k = kk;
-	allseq[k] = hypostack[q].seq;
-	alloffset[k] = hypostack[q].offset;
-	allscore[k] = hypostack[q].score;
-	allnhypo[k] = q;
-	allpredi[k] = hypostack[q].predi;
-	allmessagebit[k] = hypostack[q].messagebit;
-	allprevbits[k] = Int(hypostack[q].prevbits); // only returning 32 (or 31) bits of these
-	allsalt[k] = Int(hypostack[q].salt);
-	allnewsalt[k] = Int(hypostack[q].newsalt);
-	--k;
-	while ((q = hypostack[q].predi) > 0)
-	{
-		allseq[k] = hypostack[q].seq;
-		alloffset[k] = hypostack[q].offset;
-		allscore[k] = hypostack[q].score;
-		allnhypo[k] = q;
-		allpredi[k] = hypostack[q].predi;
-		allmessagebit[k] = hypostack[q].messagebit;
-		allprevbits[k] = Int(hypostack[q].prevbits); // only returning 32 (or 31) bits of these
-		allsalt[k] = Int(hypostack[q].salt);
-		allnewsalt[k] = Int(hypostack[q].newsalt);
-		--k;
+	StateTable() : stamp(1) {}
+	void clear()
+	{
+		Int i;
+		if (tab.size() == 0 || stamp == numeric_limits<Int>::max())
+		{ // first use, or stamps wrap around: really clear
+			tab.resize(4 * nsets);
+			for (i = 0; i < Int(tab.size()); i++)
+				tab[i].stamp = 0;
+			stamp = 0;
+		}
+		++stamp;
 	}
-}
+	template <class Same>
+	Entry &lookup(Ullong hash, Same same)
+	{
+		// the entry whose index is in the same state, if there is one. Otherwise an entry in
+		// which to put it, with an old stamp: either an empty one, or else one to evict.
+		Int i, set = 4 * Int(hash & (nsets - 1)), empty = -1;
+		for (i = set; i < set + 4; i++)
+		{
+			Entry &e = tab[i];
+			if (e.stamp != stamp)
+				empty = i;
+			else if (e.hash == hash && same(e.index))
+				return e;
+		}
+		Entry &e = tab[empty >= 0 ? empty : set + Int(hash >> 62)];
+		e.stamp = 0;
+		return e;
+	}
+};
 
-static PyObject *releaseall(PyObject *self, PyObject *pyargs)
+// A decoder context owns everything that a decode touches: its own copy of the
+// code-rate pattern, DNA constraints and scores (snapshotted from the globals by
+// loadsettings()), the hypothesis stack and heap, and the results of the last decode.
+// Distinct contexts may decode concurrently in different threads; one context may not.
+// Those threads run without the GIL, and NRvector allocates through Python, so whatever
+// a decode allocates (working storage and results alike) is in std::vectors.
+struct HedgesDecoder
 {
-	NRpyArgs args(pyargs);
-	heap.reinit();
-	hypostack.resize(NSTAK);
-	allseq.resize(0);
-	alloffset.resize(0);
-	allscore.resize(0);
-	allpredi.resize(0);
-	allmessagebit.resize(0);
-	allprevbits.resize(0);
-	allsalt.resize(0);
-	allnewsalt.resize(0);
-	return NRpyObject(Int(0));
-}
+	// settings, copied from the globals by loadsettings()
+	Int MAXSEQ, NSTAK, HLIMIT;
+	Int LPRIMER, NSP;
+	VecUllong primersalt;
+	VecInt pattarr;
+	DNAConstraints dnacon;
+	Doub reward, substitution, deletion, insertion, dither;
+	VecDoub qualityweight;
+	Int PATTERN;
+	Int BUCKETS, LAZY, STRANDLEN, MERGE, DPBAND, DPKEEP, PRIMERDP, SPECIALIZE;
+	Ullong RANSEED;
+	Int BEAMWIDTH; // not a global setting: set per call, 0 for best-first search
+	Int PEEK;	   // ditto, nonzero in peekid_C: the leading message bits for which best-first search
+				   // also looks for a runner-up that decodes them otherwise
+	const atomic<Int> *stopat; // ditto, set in RateRace (else NULL): best-first search gives up past this many moves
 
-VecUchar decode_C(GF4word &codetext, Int nmessbits = 0)
-{
-	codetext_g = &codetext[0]; // set the pointer
-	codetextlen_g = codetext.size();
-	init_heap_and_stack();
-	shoveltheheap(codetext.size(), nmessbits); // THIS WAS BUG: //last arg was nmessbits, but now always do whole codetext
-	VecMbit trba = traceback();
-	VecUchar pack = packvbits(trba, nmessbits); // truncate only at the end
-	return pack;
-}
+	// working storage
+	HypoStore hypostack;
+	HypoScheduler heap;
+	HypoBuckets buckets;
+	StateTable states; // used by MERGE
+	Ran ran;			 // for dither
+	GF4char *codetext_g; // set in decode, used by init_from_predecessor
+	const Uchar *quality_g; // ditto, Phred score of each base of codetext, or NULL for none
+	Int codetextlen_g;	 // ditto
+	Int nreads_g;		 // ditto, reads decoded jointly (1 except in decode_joint_C)
+	vector<GF4char *> codetexts_g; // ditto, when nreads_g > 1, each of length codetextlen_g ([0] is codetext_g)
+	Doub lattice;		 // set in shoveltheheap, see scorelattice()
+	Doub invlattice;	 // ditto, 1./lattice
+	Doub optimistic[3];	 // ditto, least possible penalty for skew = -1, 0, 1
+	Int enddrift;		 // ditto, with STRANDLEN: insertions less deletions in the whole read
+	Int endslack;		 // ditto, the moves after the search stops at nmessbits, which can make that much drift unseen
+	Doub aligncost[2];	 // ditto, least extra cost of each insertion, deletion still needed (0 if not aligning)
+	vector<Int> beams[3], deleted; // used by beamsearch
+	vector<Int> cellhypo[2];	   // used by bandsearch: DPKEEP slots per cell, for this seq and the next
+	vector<float> cellscore[2];	   // ditto, the scores of the hypotheses in them, side by side
+	vector<Ullong> cellstate[2];   // ditto, their statehash
+	vector<float> cellworst;	   // ditto, the worst score in each cell for the next seq
+	struct Expansion
+	{ // what all the successors of one hypothesis have in common
+		Int pred, seq, nbits, offset, mod, digest; // seq and nbits are the successors', offset the predecessor's
+		Ullong salt, prevbits, key;				   // key is what digest() hashes
+		GF4reg prevcode;
+		float score;
+		Uchar dnac_ok[4];
+	};
+	vector<Expansion> expansions; // ditto
+	vector<Ullong> keys, hashes;  // ditto
+	vector<Doub> primerdp;		  // used by primerfront: best score for each seq and offset in the primer
+	vector<Char> primerskew;	  // ditto, the move that got it
+	Int primerhypo, nprimer;	  // ditto, the hypotheses at the primer's end are primerhypo.. (nprimer of them)
+	vector<Int> reachedat;		  // with stopat, the moves made by the time each offset was first reached
 
-void decode_fulldata_C(GF4word codetext)
-{
-	codetext_g = &codetext[0]; // set the pointer
-	codetextlen_g = codetext.size();
-	init_heap_and_stack();
-	shoveltheheap(codetext.size(), 0);
-	traceback_fulldata(hypostack);
-}
+	// results of the last decode
+	vector<Mbit> path;		 // the vbits on the way to nfinal, set by traceback()
+	vector<Uchar> plaintext; // the message bytes they pack into (or the ID, after peekid_C)
+	Int nhypo, errcode, nfinal;
+	Int nexpanded; // moves scored and queued; with LAZY, nhypo counts only those materialized
+	Int nmerged;   // with MERGE, hypotheses dropped because a better one was in the same state
+	Doub finalscore;
+	Int finaloffset, finalseq;
+	Doub margin;   // with PEEK, how much worse the best message with other bits scores (at least)
+	Int peekbest;  // ditto, the best hypothesis to finish, or -1
+	Doub peekscore; // ditto, its priority
+	Doub peekenough; // ditto, a margin past which the runner-up is not looked for
+	Ullong peekbits; // ditto, its message bits
 
-static PyObject *decode(PyObject *self, PyObject *pyargs)
-{
-	NRpyArgs args(pyargs);
-	Int nmessbits;
-	if (args.size() == 1)
+	HedgesDecoder() : BEAMWIDTH(0), PEEK(0), stopat(NULL), ran(::RANSEED != 0 ? ::RANSEED : ::ran.int64()), quality_g(NULL), nreads_g(1), lattice(0.), invlattice(0.), primerhypo(0), nprimer(0), nhypo(0), errcode(0), nfinal(0), nexpanded(0), nmerged(0), finalscore(0.), finaloffset(0), finalseq(0), margin(0.), peekbest(-1), peekscore(0.), peekenough(0.), peekbits(0)
 	{
-		nmessbits = 0;
+		loadsettings();
 	}
-	else if (args.size() == 2)
+	void loadsettings()
+	{ // take a snapshot of the current global settings
+		MAXSEQ = ::MAXSEQ;
+		NSTAK = ::NSTAK;
+		HLIMIT = ::HLIMIT;
+		LPRIMER = ::LPRIMER;
+		NSP = ::NSP;
+		primersalt = ::primersalt;
+		pattarr = ::pattarr;
+		PATTERN = ::PATTERN;
+		dnacon = ::dnacon;
+		reward = ::reward;
+		substitution = ::substitution;
+		deletion = ::deletion;
+		insertion = ::insertion;
+		dither = ::dither;
+		qualityweight = ::qualityweight;
+		BUCKETS = ::BUCKETS;
+		LAZY = ::LAZY;
+		STRANDLEN = ::STRANDLEN;
+		MERGE = ::MERGE;
+		DPBAND = ::DPBAND;
+		DPKEEP = ::DPKEEP;
+		PRIMERDP = ::PRIMERDP;
+		SPECIALIZE = ::SPECIALIZE;
+		RANSEED = ::RANSEED;
+	}
+	void setcoderate(Int pattnumber, const char *leftpr, const char *rightpr)
+	{ // as setcoderate_C, but for this context alone (after loadsettings), leaving the globals be
+		GF4word left, right;
+		VecUchar patt(pattrn);
+		findprimersalt(leftpr, rightpr, left, right, primersalt);
+		LPRIMER = left.size();
+		standardpattern(pattnumber, patt, reward);
+		if (pattnumber >= 1 && pattnumber <= 6)
+			PATTERN = pattnumber;
+		fillpattarr(pattarr, patt, LPRIMER, MAXSEQ);
+		NSP = vbitlen(NSALT, pattarr, MAXSEQ) + LPRIMER;
+	}
+	void release()
+	{ // give back heap and hypostack memory
+		heap.reinit();
+		buckets.reinit();
+		hypostack.release(NSTAK);
+	}
+	void init_heap_and_stack()
+	{
+		hypostack.reserve(NSTAK);
+		init_root(0);
+		nhypo = 1;
+		seeddither();
+	}
+	void seeddither()
+	{ // with RANSEED, a read's dither is a substream picked by the read itself, so that its decode is the
+		// same whichever thread does it, and whatever that thread decoded before (codetext_g must be set)
+		Int r, k, j;
+		Ullong key = Ullong(codetextlen_g), w;
+		Ranhash hash;
+		if (RANSEED == 0 || dither <= 0.)
+			return;
+		for (r = 0; r < nreads_g; r++)
+		{
+			const GF4char *c = (r == 0 ? codetext_g : codetexts_g[r]);
+			for (k = 0; k < codetextlen_g; k += 32)
+			{
+				for (j = k, w = 0; j < MIN(k + 32, codetextlen_g); j++)
+					w = (w << 2) | (c[j] & 3);
+				key = hash.int64(key ^ w);
+			}
+		}
+		ran = Ran(streamseed(RANSEED, key));
+	}
+	void init_root(Int h)
+	{
+		HypoStore::Chunk &c = hypostack.chunk(h);
+		Int i = h & HypoStore::CHUNKMASK;
+		c.predi[i] = -1;
+		c.offset[i] = -1;
+		c.seq[i] = -1;
+		c.messagebit[i] = 0; // not really a message bit
+		c.dropped[i] = 0;
+		c.prevbits[i] = 0;
+		c.score[i] = 0.f;
+		c.salt[i] = 0;
+		c.prevcode[i] = acgtacgt;
+		for (Int r = 0; r < hypostack.nother; r++)
+			hypostack.otheroffsets(h)[r] = -1;
+	}
+	// Kernels: the expansion steps are templates on the code-rate pattern (PATT 1..6 as setcoderate, else 0 for
+	// any in pattarr) and on the DNA constraints (DNAC), so that searchwith can pick code compiled for both.
+	// ANYDNAC is the generic path, the one other searches use; it gives the same hypotheses as the rest.
+	enum { ANYDNAC, CONSTRAINED, UNCONSTRAINED };
+	template <Int PATT>
+	inline Int vbits(Int seq)
+	{ // pattarr[seq], but for a standard pattern worked out without a (bounds-checked) lookup
+		if (PATT == 0 || seq >= MAXSEQ)
+			return pattarr[seq];
+		if (seq < LPRIMER)
+			return 0;
+		switch (PATT)
+		{ // as fillpattarr: pattrn[seq % npattrn]
+		case 1:
+			return (seq % 2 == 0 ? 2 : 1);
+		case 2:
+			return (seq % 5 == 0 ? 2 : 1);
+		case 4:
+			return (seq % 3 == 2 ? 0 : 1);
+		case 5:
+			return (seq % 2 == 0 ? 1 : 0);
+		case 6:
+			return (seq % 3 == 0 ? 1 : 0);
+		default:
+			return 1;
+		}
+	}
+	template <Int DNAC>
+	static inline Int reduce(Ullong x, Int mod)
+	{ // x % mod for a mod of 1..4 (always 4 unconstrained), without a division in the specialized kernels
+		if (DNAC == ANYDNAC)
+			return Int(x % mod);
+		if (DNAC == UNCONSTRAINED)
+			return Int(x & 3);
+		return Int(mod == 3 ? x % 3 : x & (mod - 1));
+	}
+	template <Int PATT = 0, Int DNAC = ANYDNAC>
+	inline void setexpansion(Expansion &ex, Int pred, bool hashnow = true);
+	template <Int PATT = 0, Int DNAC = ANYDNAC>
+	inline Int init_successor(Int h, const Expansion &ex, Mbit mbit, Int skew, Int mover = 0);
+	inline Doub penalty(Int regout, const GF4char *codetext, const Uchar *quality, Int offset, Int skew)
+	{ // what one read charges for a move that predicts regout
+		Doub compared;
+		if (skew < 0) // deletion
+			return deletion;
+		compared = (regout == codetext[offset] ? reward : substitution); // the only place where a check is possible!
+		if (quality != NULL) // a doubtful base is worth less, whether it agrees or not
+			compared *= qualityweight[quality[offset]];
+		return (skew == 0 ? compared : insertion + compared); // substitution or insertion
+	}
+	template <Int PATT, Int DNAC>
+	inline Int init_from_predecessor(Int h, Int pred, Mbit mbit, Int skew)
+	{ // fill hypothesis h as a successor of hypothesis pred
+		Expansion ex;
+		setexpansion<PATT, DNAC>(ex, pred);
+		return init_successor<PATT, DNAC>(h, ex, mbit, skew);
+	}
+	Doub scorelattice()
+	{
+		// if every score is (to within rounding) an integer multiple of 1/m for some m <= 10000,
+		// then so is every hypothesis score, and a bucket queue can order them exactly: return m.
+		// return 0. if there is no such m, or if dither or base qualities make the scores continuous.
+		Doub sc[4] = {reward, substitution, deletion, insertion}, x;
+		Int i, m;
+		if (dither > 0. || quality_g != NULL)
+			return 0.;
+		for (m = 1; m <= 10000; m++)
+		{
+			for (i = 0; i < 4; i++)
+			{
+				x = sc[i] * m;
+				if (abs(x - floor(x + 0.5)) > 1.e-6)
+					break;
+			}
+			if (i == 4)
+				return Doub(m);
+		}
+		return 0.;
+	}
+	void shoveltheheap(Int limit, Int nmessbits)
+	{ // pick a scheduler and search with it
+		lattice = scorelattice();
+		invlattice = (lattice > 0. ? 1. / lattice : 0.);
+		Doub best = MIN(reward, substitution) - (dither > 0. ? dither : 0.);
+		if (quality_g != NULL) // scaled by weights in [0, 1]
+			best = MIN(best, 0.);
+		optimistic[0] = deletion - (dither > 0. ? dither : 0.);
+		optimistic[1] = best;
+		optimistic[2] = insertion + best;
+		enddrift = codetextlen_g - STRANDLEN;
+		endslack = 0;
+		aligncost[0] = aligncost[1] = 0.;
+		if (STRANDLEN > 0 && optimistic[2] >= best && optimistic[0] >= best)
+		{ // else an indel might cost less than a substitution, and there is no bound
+			aligncost[0] = optimistic[2] - best;
+			aligncost[1] = optimistic[0] - best;
+		}
+		nmerged = 0;
+		peekbest = -1;
+		margin = 0.;
+		primerhypo = nprimer = 0;
+		if (MERGE)
+			states.clear();
+		if (searchproblem(LAZY, HLIMIT, DPBAND, DPKEEP) != NULL || nmessbits > maxmessbits(pattarr, MAXSEQ))
+		{ // the search can't run: the result is the root, an empty message
+			errcode = 3;
+			nexpanded = 0;
+			nfinal = 0;
+			return;
+		}
+		if (nmessbits > 0)
+			endslack = MAX(0, STRANDLEN - vbitlen(nmessbits, pattarr, MAXSEQ));
+		if (BEAMWIDTH > 0 && nreads_g == 1) // both sweep the offsets of one read
+			beamsearch(limit, nmessbits);
+		else if (DPBAND > 0 && nreads_g == 1)
+			bandsearch(limit, nmessbits);
+		else if (BUCKETS && lattice > 0.)
+		{
+			buckets.setlattice(lattice);
+			searchwith(buckets, limit, nmessbits);
+		}
+		else
+		{
+			heap.rewind();
+			searchwith(heap, limit, nmessbits);
+		}
+		if (nprimer > 0)
+			primerpath(nfinal);
+	}
+	template <class Scheduler>
+	void searchwith(Scheduler &heap, Int limit, Int nmessbits)
+	{ // best-first search with the kernel for this pattern and constraint mode, or the generic one
+		typedef void (HedgesDecoder::*Kernel)(Scheduler &, Int, Int);
+		static const Kernel kernels[7][2] = {
+			{&HedgesDecoder::shoveltheheap<Scheduler, 0, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 0, UNCONSTRAINED>},
+			{&HedgesDecoder::shoveltheheap<Scheduler, 1, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 1, UNCONSTRAINED>},
+			{&HedgesDecoder::shoveltheheap<Scheduler, 2, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 2, UNCONSTRAINED>},
+			{&HedgesDecoder::shoveltheheap<Scheduler, 3, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 3, UNCONSTRAINED>},
+			{&HedgesDecoder::shoveltheheap<Scheduler, 4, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 4, UNCONSTRAINED>},
+			{&HedgesDecoder::shoveltheheap<Scheduler, 5, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 5, UNCONSTRAINED>},
+			{&HedgesDecoder::shoveltheheap<Scheduler, 6, CONSTRAINED>, &HedgesDecoder::shoveltheheap<Scheduler, 6, UNCONSTRAINED>}};
+		Int patt = (PATTERN >= 1 && PATTERN <= 6 && pattarr.size() == MAXSEQ + 2 ? PATTERN : 0); // (setparams can change MAXSEQ alone)
+		if (SPECIALIZE)
+			(this->*kernels[patt][dnacon.DNAWINDOW > 0 ? 0 : 1])(heap, limit, nmessbits);
+		else
+			shoveltheheap<Scheduler, 0, ANYDNAC>(heap, limit, nmessbits);
+	}
+	template <class Scheduler, Int PATT, Int DNAC>
+	void shoveltheheap(Scheduler &heap, Int limit, Int nmessbits);
+	void beamsearch(Int limit, Int nmessbits);
+	void bandsearch(Int limit, Int nmessbits);
+	void primerfront();
+	void primerpath(Int h);
+	float primerscore(Doub score)
+	{ // as init_successor stores it
+		if (lattice > 0.)
+			score = floor(score * lattice + 0.5) * invlattice;
+		return float(score);
+	}
+	float scoreestimate(Int pred, Int skew)
+	{ // lower bound on the score of a successor of pred, rounded just as init_from_predecessor rounds
+		Doub score = hypostack.score(pred) + optimistic[skew + 1];
+		if (lattice > 0.)
+			score = floor(score * lattice + 0.5) * invlattice;
+		return float(score);
+	}
+	inline Doub endcost(Int seq, Int offset)
+	{
+		// every step shifts offset - seq by -1, 0, or +1 (deletion, substitution, insertion), and it must
+		// end up as enddrift, so |need| more indels will cost at least |need|*aligncost over substituting.
+		// But a search that stops at nmessbits leaves endslack steps unsearched, and they can make up to
+		// endslack of the drift for free; so only the indels beyond that must be paid before the search
+		// ends. Nor are the |enddrift| that the root already needs charged: charging them would make each
+		// indel toward enddrift free, anywhere. Either way it is a lower bound on the cost still to come.
+		Int need = enddrift - (offset - seq), excess = abs(need) - MAX(abs(enddrift), endslack);
+		if (excess <= 0)
+			return 0.;
+		return (need > 0 ? excess * aligncost[0] : excess * aligncost[1]);
+	}
+	struct SameState
+	{ // for StateTable::lookup: is hypothesis k in the same state as h?
+		HypoStore &hs;
+		Int h;
+		SameState(HypoStore &hsin, Int hin) : hs(hsin), h(hin) {}
+		bool operator()(Int k) const
+		{
+			if (!(hs.seq(k) == hs.seq(h) && hs.offset(k) == hs.offset(h) && hs.prevbits(k) == hs.prevbits(h) &&
+				  hs.salt(k) == hs.salt(h) && hs.prevcode(k) == hs.prevcode(h)))
+				return false;
+			for (Int r = 0; r < hs.nother; r++)
+				if (hs.otheroffsets(k)[r] != hs.otheroffsets(h)[r])
+					return false;
+			return true;
+		}
+	};
+	Ullong statehash(Int h)
+	{ // the state: everything that the successors of h depend on, except its score
+		Ullong hash = ranhash.int64(hypostack.prevcode(h) ^ ranhash.int64((Ullong(hypostack.seq(h)) << 44) ^
+			(Ullong(hypostack.offset(h)) << 32) ^ (Ullong(hypostack.salt(h)) << 8) ^ hypostack.prevbits(h)));
+		for (Int r = 0; r < hypostack.nother; r++) // in a joint decode, the other reads' offsets too
+			hash = ranhash.int64(hash ^ Ullong(hypostack.otheroffsets(h)[r]));
+		return hash;
+	}
+	bool merged(Int h)
+	{
+		// true if a hypothesis no worse than h is already in h's state, so h can be dropped. Otherwise
+		// h becomes the one for its state, and any worse one already there is superseded: since they
+		// have the same successors except for score, none of its own can ever beat those of h.
+		Ullong hash = statehash(h);
+		StateTable::Entry &e = states.lookup(hash, SameState(hypostack, h));
+		if (e.stamp != states.stamp)
+		{
+			e.hash = hash;
+			e.index = h;
+			e.stamp = states.stamp;
+		}
+		else if (hypostack.score(e.index) <= hypostack.score(h))
+		{
+			nmerged++;
+			return true;
+		}
+		else
+		{
+			hypostack.dropped(e.index) = 1; // it may already be queued, so mark it
+			e.index = h;
+			nmerged++;
+		}
+		return false;
+	}
+	inline Doub priority(Int h)
+	{ // a hypothesis's key in the scheduler
+		return hypostack.score(h) + endcost(hypostack.seq(h), hypostack.offset(h));
+	}
+	Doub getscore(Int h)
+	{ // a hypothesis score in full precision
+		Doub s = hypostack.score(h);
+		return (lattice > 0. ? floor(s * lattice + 0.5) / lattice : s);
+	}
+	void traceback();
+	Ullong pathbits(Int h, Int nmessbits)
+	{ // the first nmessbits (<= 63) message bits on the path to h, in the order packvbits packs them
+		// (the path can hold many more, so the bits past nmessbits are never shifted in)
+		Int k, nbits, end = 0;
+		Ullong bits = 0;
+		for (k = h; k > 0; k = hypostack.predi(k))
+			end += pattarr[hypostack.seq(k)]; // where the path's bits end
+		for (; h > 0; h = hypostack.predi(h))
+		{
+			nbits = pattarr[hypostack.seq(h)];
+			end -= nbits; // now where h's bits start
+			if (end + nbits <= nmessbits)
+				bits |= Ullong(hypostack.messagebit(h)) << (nmessbits - end - nbits);
+			else if (end < nmessbits)
+				bits |= Ullong(hypostack.messagebit(h)) >> (end + nbits - nmessbits);
+		}
+		return bits;
+	}
+	bool finished(Int h, Doub score)
+	{
+		// h has reached the end: true if the search is over. With PEEK the first such is the best, and
+		// the search goes on to the first whose leading PEEK bits differ; the margin is the gap.
+		Ullong bits;
+		if (!PEEK)
+			return true;
+		bits = pathbits(h, PEEK);
+		if (peekbest < 0)
+		{
+			peekbest = h;
+			peekscore = score;
+			peekbits = bits;
+			return false;
+		}
+		if (bits == peekbits)
+			return false;
+		margin = score - peekscore;
+		return true;
+	}
+};
+
+template <Int PATT, Int DNAC>
+inline void HedgesDecoder::setexpansion(Expansion &ex, Int pred, bool hashnow)
+{
+	// everything about the successors of pred that doesn't depend on their mbit or skew, including
+	// the hash (unless the caller will hash many keys at once, and then set digest itself)
+	Ullong mysalt;
+	HypoStore::Chunk &hp = hypostack.chunk(pred);
+	Int ip = pred & HypoStore::CHUNKMASK;
+	ex.pred = pred;
+	ex.seq = hp.seq[ip] + 1; // < MAXSEQ: the searches stop short of it, with errcode 3
+	ex.nbits = vbits<PATT>(ex.seq);
+	ex.offset = hp.offset[ip];
+	ex.score = hp.score[ip];
+	ex.salt = hp.salt[ip];
+	ex.prevbits = hp.prevbits[ip];
+	ex.prevcode = hp.prevcode[ip];
+	if (ex.seq < LPRIMER)
+		mysalt = primersalt[ex.seq];
+	else if (ex.seq < NSP)
+		mysalt = 0;
+	else
+		mysalt = ex.salt; // at seq == NSP, newsalt becomes the salt
+	ex.mod = (ex.seq < LPRIMER || DNAC == UNCONSTRAINED ? 4 : dnacon.allowed(ex.prevcode, ex.dnac_ok));
+	ex.key = digestkey(ex.prevbits, ex.seq, mysalt);
+	if (hashnow)
+		ex.digest = reduce<DNAC>(ranhash.int64(ex.key), ex.mod);
+}
+
+template <Int PATT, Int DNAC>
+inline Int HedgesDecoder::init_successor(Int h, const Expansion &ex, Mbit mbit, Int skew, Int mover)
+{
+	// fill hypothesis h as the successor of ex.pred with this mbit, and with this skew in read mover
+	// (in a joint decode, the other reads take skew 0; otherwise mover is 0, the only read)
+	Int r, regout, myoffset, offset = ex.offset + 1 + (mover == 0 ? skew : 0);
+	Doub mypenalty, score;
+	Ullong salt = ex.salt;
+	if (offset >= codetextlen_g)
+		return 0; // i.e., false
+	if (ex.seq >= LPRIMER && ex.seq < NSP)
+		salt = ((salt << 1) & saltmask) ^ mbit; // this is newsalt. variable bits overlap, but that's ok with XOR
+	// calculate predicted message under this hypothesis
+	regout = reduce<DNAC>(ex.digest + Uchar(mbit), ex.mod);
+	regout = (ex.seq < LPRIMER || DNAC == UNCONSTRAINED ? regout : ex.dnac_ok[regout]); // (unconstrained, all 4 ok)
+	// compare to observed message and score
+	mypenalty = penalty(regout, codetext_g, quality_g, offset, mover == 0 ? skew : 0);
+	for (r = 1; r < nreads_g; r++)
+	{ // each other read, by the same rule, at its own offset
+		myoffset = hypostack.otheroffsets(ex.pred)[r - 1] + 1 + (mover == r ? skew : 0);
+		if (myoffset >= codetextlen_g)
+			return 0;
+		hypostack.otheroffsets(h)[r - 1] = myoffset;
+		mypenalty += penalty(regout, codetexts_g[r], NULL, myoffset, mover == r ? skew : 0);
+	}
+	if (dither > 0.)
+		mypenalty += dither * (2. * ran.doub() - 1.);
+	score = ex.score + mypenalty;
+	if (lattice > 0.) // re-snap to the lattice, so that single precision never drifts
+		score = floor(score * lattice + 0.5) * invlattice;
+	HypoStore::Chunk &me = hypostack.chunk(h);
+	Int i = h & HypoStore::CHUNKMASK;
+	me.predi[i] = ex.pred;
+	me.offset[i] = offset;
+	me.seq[i] = ex.seq;
+	me.score[i] = float(score);
+	me.salt[i] = Uint(salt);
+	me.prevcode[i] = ((ex.prevcode << 2) | regout) & dnacon.dnawinmask;
+	me.prevbits[i] = Uchar(((ex.prevbits << ex.nbits) & prevmask) | mbit); // variable number
+	me.messagebit[i] = mbit;
+	me.dropped[i] = 0;
+	return 1; // i.e., true
+}
+
+template <class Scheduler, Int PATT, Int DNAC>
+void HedgesDecoder::shoveltheheap(Scheduler &heap, Int limit, Int nmessbits)
+{
+	// given an empty heap, push the root and keep processing it until offset limit, hypothesis limit, or an error is reached
+	// with LAZY, the heap also holds deferred moves, with cargo ~(pred << 4 | (skew + 1) << 2 | mbit).
+	// In a joint decode, each read in turn may take the deletion or insertion while the rest substitute
+	Int qq, move, skew, mover, seq, offset, nguess, qqmax = -1, ofmax = -1, seqmax = vbitlen(nmessbits, pattarr, MAXSEQ);
+	Int nmoves = 1 + 2 * nreads_g;
+	static const Int skews[3] = {0, -1, 1}; // substitution, deletion, insertion
+	bool lazy = (LAZY && nreads_g == 1);	// cargo has no room to say which read moved
+	Uchar mbit;
+	Doub currscore;
+	Doub estimate;
+	Expansion ex;
+	errcode = 0;
+	nexpanded = 0;
+	if (stopat != NULL)
+		reachedat.assign(codetextlen_g, numeric_limits<Int>::max());
+	primerfront();
+	if (nprimer == 0)
+		heap.push(priority(0), 0);
+	for (qq = primerhypo; qq < primerhypo + nprimer; qq++)
+		heap.push(priority(qq), qq);
+	while (true)
+	{
+		currscore = heap.pop(qq);
+		if (nhypo + 4 * nmoves >= hypostack.capacity())
+			hypostack.reserve(nhypo + 4 * nmoves + 1); // adds a chunk, moves nothing
+		if (qq < 0)
+		{ // a deferred move: materialize it, and requeue it if its estimate was too optimistic
+			move = ~qq;
+			if (MERGE && hypostack.dropped(move >> 4))
+				continue; // a better predecessor in the same state makes this same move
+			init_from_predecessor<PATT, DNAC>(nhypo, move >> 4, Mbit(move & 3), ((move >> 2) & 3) - 1);
+			if (MERGE && merged(nhypo))
+				continue;
+			qq = nhypo++;
+			if (priority(qq) > currscore)
+			{
+				heap.push(priority(qq), qq);
+				continue;
+			}
+		}
+		else if (MERGE && hypostack.dropped(qq))
+			continue; // its successors would all be worse than those of the one that replaced it
+		seq = hypostack.seq(qq);
+		offset = hypostack.offset(qq);
+		nguess = 1 << vbits<PATT>(seq + 1); // i.e., 1, 2, or 4
+		if (offset > ofmax)
+		{ // keep track of farthest gotten to
+			ofmax = offset;
+			qqmax = qq;
+			if (stopat != NULL)
+				reachedat[offset] = nexpanded;
+		}
+		if (currscore > 1.e10)
+		{ // heap is empty
+			if (peekbest >= 0)
+				margin = currscore - peekscore; // nothing else fits at all
+			break;
+		}
+		if (peekbest >= 0 && currscore - peekscore >= peekenough)
+		{ // sure enough: anything that decodes the ID otherwise scores at least this much worse
+			margin = currscore - peekscore;
+			break;
+		}
+		if (offset >= limit - 1 || (nmessbits > 0 && seq >= seqmax - 1))
+		{ // errcode 0 (nominal success), the latter when no. of message bits specified
+			if (finished(qq, currscore))
+				break;
+			continue;
+		}
+		if (nexpanded >= HLIMIT || (stopat != NULL && nexpanded > stopat->load(memory_order_relaxed)))
+		{ // i.e., nhypo > HLIMIT, unless LAZY
+			if (peekbest >= 0)
+			{ // the runner-up is out of reach, so worse than anything still queued
+				margin = currscore - peekscore;
+				nfinal = peekbest;
+				return;
+			}
+			errcode = 2;
+			nfinal = qqmax;
+			return;
+		}
+		if (seq >= MAXSEQ - 1)
+		{ // its successors would not fit (see packvbits)
+			errcode = 3;
+			nfinal = qqmax;
+			return;
+		}
+		if (!lazy)
+			setexpansion<PATT, DNAC>(ex, qq); // one hash serves all the successors
+		for (move = 0; move < nmoves; move++)
+		{
+			skew = skews[move == 0 ? 0 : 2 - (move & 1)];
+			mover = (move == 0 ? 0 : (move - 1) >> 1);
+			if (lazy)
+			{ // queue the moves, skipping those init_from_predecessor would reject
+				if (offset + 1 + skew >= codetextlen_g)
+					continue;
+				estimate = scoreestimate(qq, skew) + endcost(seq + 1, offset + 1 + skew);
+				for (mbit = 0; mbit < nguess; mbit++)
+					heap.push(estimate, ~((qq << 4) | ((skew + 1) << 2) | mbit));
+				nexpanded += nguess;
+			}
+			else
+			{
+				for (mbit = 0; mbit < nguess; mbit++)
+				{
+					if (init_successor<PATT, DNAC>(nhypo, ex, mbit, skew, mover))
+					{
+						nexpanded++;
+						if (MERGE && merged(nhypo))
+							continue; // and reuse the slot
+						heap.push(priority(nhypo), nhypo);
+						nhypo++;
+					}
+				}
+			}
+		}
+	}
+	nfinal = (peekbest >= 0 ? peekbest : qq); // final position
+}
+
+struct ScoreOrder
+{ // orders hypothesis indices by score, for beamsearch
+	HypoStore &hypostack;
+	ScoreOrder(HypoStore &hs) : hypostack(hs) {}
+	bool operator()(Int a, Int b) { return hypostack.score(a) < hypostack.score(b); }
+};
+
+void HedgesDecoder::primerfront()
+{
+	// every read starts with the same left primer, where each step predicts a known base and carries no
+	// message bits, so hypotheses there differ only in offset and score. Rather than search them, align
+	// the primer by dynamic programming (the same moves and scores, but only the best for each offset
+	// after each primer base) and start the search from one hypothesis for each offset at its end. Their
+	// paths share one spine of placeholders, filled in for the winner by primerpath. Sets nprimer to 0,
+	// and the search starts from the root, with dither (whose scores are random) or a joint decode.
+	static const Doub NONE = numeric_limits<Doub>::max();
+	static const Int PRIMERBAND = 8; // net indels in the primer beyond this are not followed
+	const Int S = LPRIMER, W = 2 * S + 1; // offsets -1 .. 2S-1 (a move reads at most 2 chars)
+	Int s, k, o, skew, regout;
+	Doub score, *from, *to;
+	Expansion ex;
+	nprimer = 0;
+	if (!PRIMERDP || S < 1 || nreads_g > 1 || dither > 0. || codetextlen_g <= S)
+		return;
+	hypostack.reserve(S + 1 + W + 12);
+	for (s = 0; s < S; s++)
+	{ // the spine: hypothesis s + 1 is at seq s (and S is a template for the end)
+		setexpansion(ex, s);
+		init_successor(s + 1, ex, 0, 0);
+	}
+	primerdp.assign((S + 1) * W, NONE); // row s + 1 is after primer base s; column o + 1 is offset o
+	primerskew.assign((S + 1) * W, 0);
+	primerdp[0] = 0.; // the root
+	for (s = 0; s < S; s++)
+	{
+		regout = hypostack.prevcode(s + 1) & 3; // what init_successor predicted
+		from = &primerdp[s * W];
+		to = &primerdp[(s + 1) * W];
+		for (k = MAX(0, s - PRIMERBAND); k <= MIN(W - 1, s + PRIMERBAND); k++)
+		{ // offsets k - 1 within the band about seq s - 1
+			if (from[k] == NONE)
+				continue;
+			for (skew = -1; skew <= 1; skew++)
+			{ // as init_successor; snapped to the lattice only at the end, which comes to the same
+				o = k + skew; // i.e., (k - 1) + 1 + skew
+				if (o >= codetextlen_g || o + 1 >= W || abs(o - s) > PRIMERBAND)
+					continue;
+				score = from[k] + penalty(regout, codetext_g, quality_g, o, skew);
+				if (score < to[o + 1])
+				{
+					to[o + 1] = score;
+					primerskew[(s + 1) * W + o + 1] = Char(skew);
+				}
+			}
+		}
+	}
+	primerhypo = S + 1;
+	setexpansion(ex, S - 1);
+	for (k = 0; k < W; k++)
+	{
+		if (primerdp[S * W + k] == NONE)
+			continue;
+		init_successor(primerhypo + nprimer, ex, 0, 0);
+		hypostack.offset(primerhypo + nprimer) = k - 1;
+		hypostack.score(primerhypo + nprimer) = primerscore(primerdp[S * W + k]);
+		nprimer++;
+	}
+	nhypo = primerhypo + nprimer;
+	nexpanded = nprimer;
+}
+
+void HedgesDecoder::primerpath(Int h)
+{ // fill in the spine with the primer alignment that leads to h, for traceback_fulldata
+	const Int S = LPRIMER, W = 2 * S + 1;
+	Int s, o;
+	while (h >= primerhypo + nprimer)
+		h = hypostack.predi(h);
+	if (h < primerhypo)
+		return; // not past the primer
+	for (s = S - 1, o = hypostack.offset(h); s > 0; s--)
+	{ // hypothesis s is at seq s - 1
+		o -= 1 + primerskew[(s + 1) * W + o + 1];
+		hypostack.offset(s) = o;
+		hypostack.score(s) = primerscore(primerdp[s * W + o + 1]);
+	}
+}
+
+void HedgesDecoder::beamsearch(Int limit, Int nmessbits)
+{
+	// alternative to shoveltheheap with bounded work: sweep through the codetext one offset at a
+	// time, keeping only the BEAMWIDTH best hypotheses that have read up to that offset, so that
+	// the hypotheses compared have all seen the same data. A move reads 0, 1, or 2 chars, so
+	// successors land in one of three beams; those of a deletion (0 chars) are swept again at the
+	// same offset, up to MAXDELS times. So at most 12*BEAMWIDTH*(MAXDELS+1) hypotheses are made per
+	// offset, and HLIMIT is not used. The best hypothesis at the last offset (or the best to reach
+	// seqmax, when nmessbits is given) wins.
+	static const Int MAXDELS = 2, skews[3] = {0, -1, 1}; // substitution, deletion, insertion
+	Int i, j, qq, t, round, move, skew, seq, nguess, nex, best = -1, qqmax = 0;
+	Int seqmax = vbitlen(nmessbits, pattarr, MAXSEQ);
+	Uchar mbit;
+	errcode = 0;
+	nexpanded = 0;
+	for (i = 0; i < 3; i++)
+		beams[i].clear();
+	beams[2].push_back(0); // the root, at offset -1
+	for (t = -1; t < limit; t++)
+	{
+		vector<Int> &beam = beams[(t + 3) % 3];
+		if (beam.size() == 0 && beams[(t + 4) % 3].size() == 0 && beams[(t + 5) % 3].size() == 0)
+			break; // nothing left to sweep
+		if (beam.size() > 0)
+			qqmax = beam[0]; // keep track of farthest gotten to (roughly)
+		for (round = 0; round <= MAXDELS && beam.size() > 0; round++)
+		{
+			if (MERGE)
+			{ // the superseded first, so that they take no places in the beam
+				for (i = 0, j = 0; i < Int(beam.size()); i++)
+					if (!hypostack.dropped(beam[i]))
+						beam[j++] = beam[i];
+				beam.resize(j);
+			}
+			if (Int(beam.size()) > BEAMWIDTH)
+			{
+				nth_element(beam.begin(), beam.begin() + BEAMWIDTH, beam.end(), ScoreOrder(hypostack));
+				beam.resize(BEAMWIDTH);
+			}
+			hypostack.reserve(nhypo + 12 * Int(beam.size()) + 1);
+			expansions.resize(beam.size());
+			keys.resize(beam.size());
+			hashes.resize(beam.size());
+			for (i = 0, nex = 0; i < Int(beam.size()); i++)
+			{ // set aside the finished, and collect the hash keys of the rest
+				qq = beam[i];
+				seq = hypostack.seq(qq);
+				if (t >= limit - 1 || (nmessbits > 0 && seq >= seqmax - 1))
+				{ // finished
+					if (best < 0 || hypostack.score(qq) < hypostack.score(best))
+						best = qq;
+					continue;
+				}
+				if (seq >= MAXSEQ - 1)
+				{ // as in shoveltheheap
+					errcode = 3;
+					nfinal = qqmax;
+					return;
+				}
+				setexpansion(expansions[nex], qq, false);
+				keys[nex] = expansions[nex].key;
+				nex++;
+			}
+			if (nex > 0)
+				ranhashbatch.int64(&keys[0], &hashes[0], nex); // the whole beam at once
+			deleted.clear();
+			for (i = 0; i < nex; i++)
+			{
+				Expansion &ex = expansions[i];
+				ex.digest = Int(hashes[i] % ex.mod);
+				nguess = 1 << ex.nbits; // i.e., 1, 2, or 4
+				for (move = 0; move < 3; move++)
+				{
+					skew = skews[move];
+					if (skew < 0 && round == MAXDELS)
+						continue;
+					for (mbit = 0; mbit < nguess; mbit++)
+					{
+						if (init_successor(nhypo, ex, mbit, skew))
+						{
+							nexpanded++;
+							if (MERGE && merged(nhypo))
+								continue;
+							(skew < 0 ? deleted : beams[(t + 4 + skew) % 3]).push_back(nhypo++);
+						}
+					}
+				}
+			}
+			beam.swap(deleted);
+		}
+		beam.clear();
+	}
+	if (best < 0)
+	{ // nothing reached the end
+		errcode = 2;
+		nfinal = qqmax;
+	}
+	else
+		nfinal = best;
+}
+
+void HedgesDecoder::bandsearch(Int limit, Int nmessbits)
+{
+	// alternative to shoveltheheap with fixed work: dynamic programming over the lattice of seq and
+	// offset. Every move advances seq by one (and offset by 0, 1, or 2), so sweeping seq one level
+	// at a time reaches each hypothesis after all of its possible predecessors. Each level keeps
+	// only offsets within DPBAND of the diagonal, offset == seq, and only the DPKEEP best hypotheses
+	// at each offset. So at most 12*DPKEEP*(2*DPBAND+1) hypotheses are made per seq, however the
+	// errors fall, and HLIMIT is not used. As in Viterbi decoding, a cell holds each state (see
+	// statehash) at most once, so its slots are not spent on one message read with different indels;
+	// this is MERGE within the cell, and MERGE itself is not used. The best hypothesis to reach the
+	// last offset (or seqmax, when nmessbits is given) wins. A cell's scores and state hashes are
+	// side by side, so its scans vectorize.
+	static const Int skews[3] = {0, -1, 1}; // substitution, deletion, insertion
+	const Int ncell = 2 * DPBAND + 1, nslot = ncell * DPKEEP;
+	const float empty = numeric_limits<float>::max();
+	Int i, j, c, qq, move, skew, nguess, nex, cur = 0, nxt, best = -1, qqmax = 0, ofmax = -1;
+	Int seqmax = vbitlen(nmessbits, pattarr, MAXSEQ);
+	Uchar mbit;
+	Ullong state, *cellst;
+	float sc, worst, *cellsc;
+	errcode = 0;
+	nexpanded = 0;
+	for (i = 0; i < 2; i++)
+	{
+		cellhypo[i].assign(nslot, -1);
+		cellscore[i].assign(nslot, empty);
+		cellstate[i].assign(nslot, 0);
+	}
+	cellhypo[cur][DPBAND * DPKEEP] = 0; // the root, at seq -1 and offset -1
+	cellscore[cur][DPBAND * DPKEEP] = 0.f;
+	expansions.resize(nslot);
+	keys.resize(nslot);
+	hashes.resize(nslot);
+	while (true)
+	{
+		for (i = 0, nex = 0; i < nslot; i++)
+		{ // set aside the finished, and collect the hash keys of the rest
+			qq = cellhypo[cur][i];
+			if (qq < 0)
+				continue;
+			if (hypostack.offset(qq) > ofmax)
+			{ // keep track of farthest gotten to
+				ofmax = hypostack.offset(qq);
+				qqmax = qq;
+			}
+			if (hypostack.offset(qq) >= limit - 1 || (nmessbits > 0 && hypostack.seq(qq) >= seqmax - 1))
+			{ // finished
+				if (best < 0 || hypostack.score(qq) < hypostack.score(best))
+					best = qq;
+				continue;
+			}
+			if (hypostack.seq(qq) >= MAXSEQ - 1)
+			{ // as in shoveltheheap
+				errcode = 3;
+				nfinal = qqmax;
+				return;
+			}
+			setexpansion(expansions[nex], qq, false);
+			keys[nex] = expansions[nex].key;
+			nex++;
+		}
+		if (nex == 0)
+			break; // nothing left to sweep
+		ranhashbatch.int64(&keys[0], &hashes[0], nex); // the whole level at once
+		hypostack.reserve(nhypo + 12 * nex + 1);
+		nxt = 1 - cur;
+		fill(cellhypo[nxt].begin(), cellhypo[nxt].end(), -1);
+		fill(cellscore[nxt].begin(), cellscore[nxt].end(), empty);
+		cellworst.assign(ncell, empty);
+		for (i = 0; i < nex; i++)
+		{
+			Expansion &ex = expansions[i];
+			ex.digest = Int(hashes[i] % ex.mod);
+			nguess = 1 << ex.nbits; // i.e., 1, 2, or 4
+			for (move = 0; move < 3; move++)
+			{
+				skew = skews[move];
+				c = (ex.offset + 1 + skew) - ex.seq + DPBAND; // the successors' cell
+				if (c < 0 || c >= ncell)
+					continue; // outside the band
+				cellsc = &cellscore[nxt][c * DPKEEP];
+				cellst = &cellstate[nxt][c * DPKEEP];
+				for (mbit = 0; mbit < nguess; mbit++)
+				{
+					if (!init_successor(nhypo, ex, mbit, skew))
+						continue;
+					nexpanded++;
+					sc = hypostack.score(nhypo);
+					if (sc >= cellworst[c])
+						continue; // and reuse the slot
+					state = statehash(nhypo);
+					for (j = 0; j < DPKEEP; j++)
+						if (cellst[j] == state && cellhypo[nxt][c * DPKEEP + j] >= 0 &&
+							SameState(hypostack, nhypo)(cellhypo[nxt][c * DPKEEP + j]))
+							break;
+					if (j < DPKEEP)
+					{ // already there: keep the better
+						nmerged++;
+						if (sc >= cellsc[j])
+							continue;
+					}
+					else
+						for (j = 0; cellsc[j] != cellworst[c]; j++)
+							; // the worst (or an empty) slot, which it replaces
+					cellsc[j] = sc;
+					cellst[j] = state;
+					cellhypo[nxt][c * DPKEEP + j] = nhypo++;
+					for (j = 0, worst = cellsc[0]; j < DPKEEP; j++)
+						worst = MAX(worst, cellsc[j]);
+					cellworst[c] = worst;
+				}
+			}
+		}
+		cur = nxt;
+	}
+	if (best < 0)
+	{ // nothing reached the end
+		errcode = 2;
+		nfinal = qqmax;
+	}
+	else
+		nfinal = best;
+}
+
+void HedgesDecoder::traceback()
+{
+	Int k, kk = 0, q = nfinal;
+	while ((q = hypostack.predi(q)) > 0)
+		++kk;			 // get length of chain
+	path.resize(kk + 1); // each with variable bits
+	finalscore = getscore(nfinal);
+	finaloffset = hypostack.offset(nfinal);
+	finalseq = hypostack.seq(nfinal);
+	q = nfinal;
+	k = kk;
+	path[k--] = hypostack.messagebit(q);
+	while ((q = hypostack.predi(q)) > 0)
+	{
+		path[k] = hypostack.messagebit(q);
+		--k;
+	}
+}
+
+// the global context, used by the single-strand Python entry points
+HedgesDecoder decoder;
+
+// global containers for fulldata
+VecInt allseq;
+VecInt allnhypo;
+VecInt alloffset;
+VecDoub allscore;
+VecInt allpredi;
+VecUchar allmessagebit;
+VecInt allprevbits;
+VecInt allsalt;
+VecInt allnewsalt;
+
+void traceback_fulldata(HedgesDecoder &dc)
+{
+	// TODO: questionable! messagebit might be 0, 1 or 2 bits.  how are you supposed to know?
+	// see packvbits()
+	HypoStore &hypostack = dc.hypostack;
+	Int k, kk = 0, nfinal = dc.nfinal, q = nfinal;
+	while ((q = hypostack.predi(q)) > 0)
+		++kk; // get length of chain
+	allseq.resize(kk + 1);
+	alloffset.resize(kk + 1);
+	allscore.resize(kk + 1);
+	allnhypo.resize(kk + 1);
+	allpredi.resize(kk + 1);
+	allmessagebit.resize(kk + 1);
+	allprevbits.resize(kk + 1);
+	allsalt.resize(kk + 1);
+	allnewsalt.resize(kk + 1);
+	dc.finalscore = dc.getscore(nfinal);
+	dc.finaloffset = hypostack.offset(nfinal);
+	dc.finalseq = hypostack.seq(nfinal);
+	q = nfinal;
+	for (k = kk; k >= 0; k--)
+	{
+		allseq[k] = hypostack.seq(q);
+		alloffset[k] = hypostack.offset(q);
+		allscore[k] = dc.getscore(q);
+		allnhypo[k] = q;
+		allpredi[k] = hypostack.predi(q);
+		allmessagebit[k] = hypostack.messagebit(q);
+		allprevbits[k] = Int(hypostack.prevbits(q));
+		allsalt[k] = (allseq[k] >= dc.NSP ? Int(hypostack.salt(q)) : 0); // the two share storage
+		allnewsalt[k] = (allseq[k] < dc.NSP ? Int(hypostack.salt(q)) : 0);
+		q = hypostack.predi(q);
+	}
+}
+
+static PyObject *releaseall(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	decoder.release();
+	allseq.resize(0);
+	alloffset.resize(0);
+	allscore.resize(0);
+	allpredi.resize(0);
+	allmessagebit.resize(0);
+	allprevbits.resize(0);
+	allsalt.resize(0);
+	allnewsalt.resize(0);
+	return NRpyObject(Int(0));
+}
+
+void decode_C(HedgesDecoder &dc, GF4char *codetext, Int len, Int nmessbits = 0, const Uchar *quality = NULL)
+{ // decode using the context's own settings (it is up to the caller to loadsettings()), into dc.plaintext
+	dc.codetext_g = codetext; // set the pointer
+	dc.quality_g = quality;
+	dc.codetextlen_g = len;
+	dc.nreads_g = 1;
+	dc.hypostack.setnother(0);
+	dc.init_heap_and_stack();
+	dc.shoveltheheap(len, nmessbits); // THIS WAS BUG: //last arg was nmessbits, but now always do whole codetext
+	dc.traceback();
+	packvbits(dc.path, nmessbits, dc.pattarr, dc.MAXSEQ, dc.plaintext); // truncate only at the end
+}
+
+void decode_C(HedgesDecoder &dc, GF4word &codetext, Int nmessbits = 0, const Uchar *quality = NULL)
+{
+	decode_C(dc, &codetext[0], codetext.size(), nmessbits, quality);
+}
+
+VecUchar plaintextof(const HedgesDecoder &dc)
+{ // dc.plaintext, as the Python entry points return it (so only with the GIL held)
+	Int n = Int(dc.plaintext.size());
+	return VecUchar(n, n > 0 ? &dc.plaintext[0] : (const Uchar *)NULL);
+}
+
+VecUchar decode_C(GF4word &codetext, Int nmessbits = 0, Int beamwidth = 0, const Uchar *quality = NULL)
+{ // decode in the global context with the current global settings
+	decoder.loadsettings();
+	decoder.BEAMWIDTH = beamwidth;
+	decode_C(decoder, codetext, nmessbits, quality);
+	return plaintextof(decoder);
+}
+
+void peekid_C(HedgesDecoder &dc, GF4char *codetext, Int len, Int budget, Int lookahead = 16, Doub enough = 1.5)
+{
+	// decode only the strand ID, the first NSALT message bits, by best-first search of at most budget
+	// moves, into dc.plaintext; dc.margin says how sure it is (up to enough, past which the search
+	// stops). Used to route raw reads before any full decode. A bit is only confirmed by the bases
+	// after it, so the search goes lookahead message bits further.
+	Int nid = (NSALT + 7) / 8;
+	dc.PEEK = NSALT;
+	dc.peekenough = enough;
+	dc.BEAMWIDTH = dc.DPBAND = 0; // which sweep the whole read
+	dc.HLIMIT = budget;
+	decode_C(dc, codetext, len, NSALT + lookahead);
+	dc.PEEK = 0;
+	dc.plaintext.resize(nid, Uchar(0)); // (zeros, if the search got no further)
+	if (NSALT & 7)
+		dc.plaintext[nid - 1] &= Uchar(0xff << (8 - (NSALT & 7)));
+}
+
+void splitid(const vector<Uchar> &id, Int &packet, Int &index)
+{ // as test_program.py lays out the ID bytes: the last is the index within the packet, the rest its number
+	Int k, n = Int(id.size());
+	packet = 0;
+	index = (n > 0 ? id[n - 1] : 0);
+	for (k = 0; k < n - 1; k++)
+		packet = (packet << 8) | id[k];
+}
+
+void decode_joint_C(HedgesDecoder &dc, MatUchar &codetexts, Int nmessbits = 0)
+{
+	// decode one message from several reads of the same strand, the rows of codetexts: each
+	// hypothesis keeps its own offset in every read, and its score sums what every read charges.
+	// Best-first search only (BEAMWIDTH, DPBAND and LAZY are not used); no qualities, no cache.
+	// MERGE is always on: the same indels taken by different reads in different orders reach
+	// one state many ways, and without merging the search would expand every one of them.
+	Int r, nreads = codetexts.nrows();
+	dc.MERGE = 1;
+	dc.codetexts_g.resize(nreads);
+	for (r = 0; r < nreads; r++)
+		dc.codetexts_g[r] = codetexts[r];
+	dc.codetext_g = codetexts[0];
+	dc.quality_g = NULL;
+	dc.codetextlen_g = codetexts.ncols();
+	dc.nreads_g = nreads;
+	dc.hypostack.setnother(nreads - 1);
+	dc.init_heap_and_stack();
+	dc.shoveltheheap(dc.codetextlen_g, nmessbits);
+	dc.traceback();
+	packvbits(dc.path, nmessbits, dc.pattarr, dc.MAXSEQ, dc.plaintext);
+}
+
+// Decode cache: PCR makes many copies of the same read, and each would otherwise be decoded in
+// full. Results are kept by a 128-bit hash of the read (and its qualities, if any) together with
+// every setting that can change the answer (see settingskey), so a false hit needs a collision of
+// both halves. Reads should be oriented (makegoodsense) first, as for decode. Like StateTable, it
+// has a fixed size, in sets of 4, and a full set evicts its least recently used entry. It is off
+// until setdecodecache sizes it, is shared by the batch workers under a lock, and is not used
+// with dither, whose decodes are random.
+struct DecodeCache
+{
+	struct Entry
+	{
+		Ullong key[2];
+		Llong used; // clock at last fill or hit, 0 if empty
+		Int errcode, nhypo, nexpanded, nmerged, finaloffset, finalseq;
+		Doub finalscore;
+		vector<Uchar> plaintext; // (filled by the workers, so not a VecUchar: see HedgesDecoder)
+		Entry() : used(0) {}
+	};
+	vector<Entry> tab;
+	atomic<Int> nsets; // read without the lock only by enabled(), so find and add check it again
+	Llong clock, hits, misses;
+	mutex lock;
+
+	DecodeCache() : nsets(0), clock(0), hits(0), misses(0) {}
+	void resize(Int nentries)
+	{ // and empty it
+		lock_guard<mutex> guard(lock);
+		nsets = (nentries > 0 ? (nentries + 3) / 4 : 0);
+		tab.assign(4 * nsets, Entry());
+		clock = hits = misses = 0;
+	}
+	bool enabled() const { return nsets > 0; }
+	void stats(Llong &nhits, Llong &nmisses, Int &nentries, Int &nfilled)
+	{
+		lock_guard<mutex> guard(lock);
+		Int i;
+		nhits = hits;
+		nmisses = misses;
+		nentries = Int(tab.size());
+		nfilled = 0;
+		for (i = 0; i < nentries; i++)
+			nfilled += (tab[i].used > 0);
+	}
+	bool find(const Ullong *key, HedgesDecoder &dc)
+	{ // on a hit, set dc's results as the original decode left them
+		lock_guard<mutex> guard(lock);
+		if (nsets == 0) // emptied by setdecodecache(0) since the caller checked enabled(): a miss
+			return false;
+		Int i, set = 4 * Int(key[0] % Ullong(nsets));
+		for (i = set; i < set + 4; i++)
+		{
+			Entry &e = tab[i];
+			if (e.used > 0 && e.key[0] == key[0] && e.key[1] == key[1])
+			{
+				e.used = ++clock;
+				hits++;
+				dc.errcode = e.errcode;
+				dc.nhypo = e.nhypo;
+				dc.nexpanded = e.nexpanded;
+				dc.nmerged = e.nmerged;
+				dc.finalscore = e.finalscore;
+				dc.finaloffset = e.finaloffset;
+				dc.finalseq = e.finalseq;
+				dc.plaintext = e.plaintext;
+				return true;
+			}
+		}
+		misses++;
+		return false;
+	}
+	void add(const Ullong *key, const HedgesDecoder &dc)
+	{
+		lock_guard<mutex> guard(lock);
+		if (nsets == 0) // ditto, so nothing to add to
+			return;
+		Int i, set = 4 * Int(key[0] % Ullong(nsets)), k = set;
+		for (i = set; i < set + 4; i++)
+		{ // the same key (another worker got there first), else the least recently used
+			if (tab[i].used > 0 && tab[i].key[0] == key[0] && tab[i].key[1] == key[1])
+			{
+				k = i;
+				break;
+			}
+			if (tab[i].used < tab[k].used)
+				k = i;
+		}
+		Entry &e = tab[k];
+		e.key[0] = key[0];
+		e.key[1] = key[1];
+		e.used = ++clock;
+		e.errcode = dc.errcode;
+		e.nhypo = dc.nhypo;
+		e.nexpanded = dc.nexpanded;
+		e.nmerged = dc.nmerged;
+		e.finalscore = dc.finalscore;
+		e.finaloffset = dc.finaloffset;
+		e.finalseq = dc.finalseq;
+		e.plaintext = dc.plaintext;
+	}
+};
+DecodeCache decodecache;
+
+inline void hashinto(Ullong *key, Ullong w)
+{ // add a word to both halves of a cache key
+	key[0] = ranhash.int64(key[0] ^ w);
+	key[1] = ranhash.int64(key[1] + (w << 32 | w >> 32));
+}
+
+inline void hashinto(Ullong *key, Doub x)
+{
+	Ullong w;
+	memcpy(&w, &x, sizeof(w));
+	hashinto(key, w);
+}
+
+Ullong settingskey(Int nmessbits, Int beamwidth)
+{ // every global setting that a decode's answer depends on, and the arguments that do
+	Int i;
+	Ullong key[2] = {0x2545F4914F6CDD1DULL, 0};
+	Ullong ints[] = {Ullong(nmessbits), Ullong(beamwidth), Ullong(MAXSEQ), Ullong(HLIMIT), Ullong(NSP),
+					 Ullong(LPRIMER), Ullong(RPRIMER), Ullong(pattarr.size()), Ullong(dnacon.DNAWINDOW),
+					 Ullong(dnacon.MAXGC), Ullong(dnacon.MINGC), Ullong(dnacon.MAXRUN), Ullong(BUCKETS),
+					 Ullong(LAZY), Ullong(STRANDLEN), Ullong(MERGE), Ullong(DPBAND), Ullong(DPKEEP),
+					 Ullong(PRIMERDP)};
+	Doub doubs[] = {reward, substitution, deletion, insertion, dither, qualityref};
+	for (i = 0; i < Int(sizeof(ints) / sizeof(ints[0])); i++)
+		hashinto(key, ints[i]);
+	for (i = 0; i < Int(sizeof(doubs) / sizeof(doubs[0])); i++)
+		hashinto(key, doubs[i]);
+	for (i = 0; i < pattrn.size(); i++)
+		hashinto(key, Ullong(pattrn[i]));
+	for (i = 0; i < leftprimer.size(); i++)
+		hashinto(key, Ullong(leftprimer[i]));
+	for (i = 0; i < rightprimer.size(); i++)
+		hashinto(key, Ullong(rightprimer[i]) << 8);
+	return key[0];
+}
+
+void readkey(const GF4char *codetext, Int len, const Uchar *quality, Ullong settings, Ullong *key)
+{ // the cache key of a read, 8 bases to a word
+	Int i, k;
+	Ullong w;
+	key[0] = settings;
+	key[1] = ~settings;
+	hashinto(key, Ullong(len) << 1 | (quality != NULL));
+	for (i = 0; i < len; i += 8)
+	{
+		for (k = 0, w = 0; k < 8 && i + k < len; k++)
+			w |= Ullong(codetext[i + k]) << (8 * k);
+		hashinto(key, w);
+	}
+	for (i = 0; quality != NULL && i < len; i += 8)
+	{
+		for (k = 0, w = 0; k < 8 && i + k < len; k++)
+			w |= Ullong(quality[i + k]) << (8 * k);
+		hashinto(key, w);
+	}
+}
+
+void decode_cached(HedgesDecoder &dc, GF4char *codetext, Int len, Int nmessbits, const Uchar *quality, Ullong settings)
+{ // decode_C, unless the same read was decoded before with the same settings
+	Ullong key[2];
+	if (!decodecache.enabled() || dc.dither > 0.)
+	{
+		decode_C(dc, codetext, len, nmessbits, quality);
+		return;
+	}
+	readkey(codetext, len, quality, settings, key);
+	if (decodecache.find(key, dc))
+		return;
+	decode_C(dc, codetext, len, nmessbits, quality);
+	decodecache.add(key, dc);
+}
+
+VecUchar decode_cached(GF4word &codetext, Int nmessbits = 0, Int beamwidth = 0, const Uchar *quality = NULL)
+{ // ditto, in the global context
+	decoder.loadsettings();
+	decoder.BEAMWIDTH = beamwidth;
+	decode_cached(decoder, &codetext[0], codetext.size(), nmessbits, quality, settingskey(nmessbits, beamwidth));
+	return plaintextof(decoder);
+}
+
+static PyObject *setdecodecache(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 1)
+	{
+		NRpyException("setdecodecache takes exactly 1 argument");
+		return NRpyObject(Int(1));
+	}
+	decodecache.resize(NRpyInt(args[0]));
+	return NRpyObject(Int(0));
+}
+
+static PyObject *getdecodecachestats(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Llong hits, misses;
+	Int nentries, nfilled;
+	decodecache.stats(hits, misses, nentries, nfilled); // under the lock, as a batch may be running
+	return NRpyTuple(
+		NRpyObject(Doub(hits)),
+		NRpyObject(Doub(misses)),
+		NRpyObject(nentries),
+		NRpyObject(nfilled),
+		NULL);
+}
+
+void decode_fulldata_C(GF4word codetext)
+{
+	decoder.loadsettings();
+	decoder.BEAMWIDTH = 0;
+	decoder.codetext_g = &codetext[0]; // set the pointer
+	decoder.quality_g = NULL;
+	decoder.codetextlen_g = codetext.size();
+	decoder.nreads_g = 1;
+	decoder.hypostack.setnother(0);
+	decoder.init_heap_and_stack();
+	decoder.shoveltheheap(codetext.size(), 0);
+	traceback_fulldata(decoder);
+}
+
+static PyObject *decode(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nmessbits = 0, beamwidth = 0;
+	VecUchar quality;
+	if (args.size() < 1 || args.size() > 4)
+	{
+		NRpyException("decode takes 1 to 4 arguments only");
+		return NRpyObject(0); // formerly NULL
+	}
+	if (args.size() > 1)
+		nmessbits = NRpyInt(args[1]);
+	if (args.size() > 2)
+		beamwidth = NRpyInt(args[2]);
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("decode requires array with dtype=uint8 \n");
+	GF4word codetext(args[0]);
+	if (args.size() > 3 && args[3] != Py_None)
+	{
+		if (PyArray_TYPE(args[3]) != PyArray_UBYTE)
+			NRpyException("decode requires array with dtype=uint8 \n");
+		quality.initpyvec(args[3]);
+		if (quality.size() < codetext.size())
+		{
+			NRpyException("decode: quality array shorter than codetext");
+			return NRpyObject(0);
+		}
+	}
+	VecUchar plaintext = decode_cached(codetext, nmessbits, beamwidth, quality.size() > 0 ? &quality[0] : NULL);
+	return NRpyTuple(
+		NRpyObject(decoder.errcode),
+		NRpyObject(plaintext),
+		NRpyObject(decoder.nhypo),
+		NRpyObject(decoder.finalscore),
+		NRpyObject(decoder.finaloffset),
+		NRpyObject(decoder.finalseq),
+		NULL);
+}
+
+static PyObject *decode_packed(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nbases, nmessbits = 0, beamwidth = 0;
+	if (args.size() < 2 || args.size() > 4)
+	{
+		NRpyException("decode_packed takes 2 to 4 arguments only");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("decode_packed requires array with dtype=uint8 \n");
+	VecUchar packed(args[0]);
+	nbases = NRpyInt(args[1]);
+	if (args.size() > 2)
+		nmessbits = NRpyInt(args[2]);
+	if (args.size() > 3)
+		beamwidth = NRpyInt(args[3]);
+	if (nbases < 1 || DNAPacker::nbytes(nbases) > packed.size())
+	{
+		NRpyException("decode_packed: packed array too short for nbases");
+		return NRpyObject(0);
+	}
+	GF4word codetext(nbases);
+	dnapacker.unpack(&packed[0], &codetext[0], nbases);
+	VecUchar plaintext = decode_cached(codetext, nmessbits, beamwidth);
+	return NRpyTuple(
+		NRpyObject(decoder.errcode),
+		NRpyObject(plaintext),
+		NRpyObject(decoder.nhypo),
+		NRpyObject(decoder.finalscore),
+		NRpyObject(decoder.finaloffset),
+		NRpyObject(decoder.finalseq),
+		NULL);
+}
+
+static PyObject *decode_joint(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nmessbits = 0;
+	if (args.size() < 1 || args.size() > 2)
+	{
+		NRpyException("decode_joint takes 1 or 2 arguments only");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("decode_joint requires array with dtype=uint8 \n");
+	MatUchar codetexts(args[0]);
+	if (args.size() > 1)
+		nmessbits = NRpyInt(args[1]);
+	if (codetexts.nrows() < 1 || codetexts.ncols() < 1)
+	{
+		NRpyException("decode_joint: no reads");
+		return NRpyObject(0);
+	}
+	decoder.loadsettings();
+	decoder.BEAMWIDTH = 0;
+	decode_joint_C(decoder, codetexts, nmessbits);
+	VecUchar plaintext = plaintextof(decoder);
+	return NRpyTuple(
+		NRpyObject(decoder.errcode),
+		NRpyObject(plaintext),
+		NRpyObject(decoder.nhypo),
+		NRpyObject(decoder.finalscore),
+		NRpyObject(decoder.finaloffset),
+		NRpyObject(decoder.finalseq),
+		NULL);
+}
+
+static PyObject *getsearchstats(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	return NRpyTuple(
+		NRpyObject(decoder.nhypo),
+		NRpyObject(decoder.nexpanded),
+		NRpyObject(decoder.nmerged),
+		NULL);
+}
+
+struct DecodeBatch
+{
+	// decode every row of a packet, each worker thread with its own decoder context.
+	// Rows are handed out one at a time from a shared counter, so a worker that drew
+	// a hard strand doesn't hold up the rest of the packet.
+	MatUchar &codetexts;
+	MatUchar *qualities; // Phred score of each base of each row, or NULL
+	Int nrows, ncols, nmessbits, beamwidth;
+	bool packed; // rows hold ncols bases at 2 bits each
+	Ullong settings; // for decodecache
+	atomic<Int> nextrow;
+	// outputs, one entry (or row) per input row
+	VecInt errcode, nhypo, offset, seq, nbytes;
+	VecDoub score;
+	MatUchar plaintext; // zero-padded; row i is valid for nbytes[i] bytes
+
+	DecodeBatch(MatUchar &codetextsin, Int nmessbitsin, Int beamwidthin = 0, Int nbases = 0) : codetexts(codetextsin),
+		qualities(NULL), nrows(codetextsin.nrows()), ncols(nbases > 0 ? nbases : codetextsin.ncols()), nmessbits(nmessbitsin),
+		beamwidth(beamwidthin), packed(nbases > 0), settings(settingskey(nmessbitsin, beamwidthin)), nextrow(0),
+		errcode(nrows, 0), nhypo(nrows, 0), offset(nrows, 0), seq(nrows, 0), nbytes(nrows, 0), score(nrows, 0.)
+	{
+		Int k, nbits = 0;
+		for (k = 0; k < ncols; k++)
+			nbits += pattarr[k]; // most message bits that a row could decode to
+		if (nmessbits > 0)
+			nbits = MIN(nbits, nmessbits);
+		plaintext.assign(nrows, MAX(1, (nbits + 7) / 8), Uchar(0));
+	}
+	void work(HedgesDecoder *dc)
+	{ // (without the GIL, so no NRvectors: see HedgesDecoder)
+		Int i, k;
+		vector<GF4char> unpacked(packed ? ncols : 1); // this worker's
+		GF4char *row;
+		while ((i = nextrow++) < nrows)
+		{
+			row = codetexts[i];
+			if (packed)
+			{
+				dnapacker.unpack(row, &unpacked[0], ncols);
+				row = &unpacked[0];
+			}
+			decode_cached(*dc, row, ncols, nmessbits, qualities ? (*qualities)[i] : NULL, settings);
+			errcode[i] = dc->errcode;
+			nhypo[i] = dc->nhypo;
+			score[i] = dc->finalscore;
+			offset[i] = dc->finaloffset;
+			seq[i] = dc->finalseq;
+			nbytes[i] = MIN(Int(dc->plaintext.size()), plaintext.ncols());
+			for (k = 0; k < nbytes[i]; k++)
+				plaintext[i][k] = dc->plaintext[k];
+		}
+	}
+	void run(Int nthreads)
+	{
+		Int t;
+		vector<HedgesDecoder> decoders(nthreads); // each takes a snapshot of the global settings
+		vector<thread> workers;
+		for (t = 0; t < nthreads; t++)
+			decoders[t].BEAMWIDTH = beamwidth;
+		Py_BEGIN_ALLOW_THREADS;
+		for (t = 1; t < nthreads; t++)
+			workers.push_back(thread(&DecodeBatch::work, this, &decoders[t]));
+		work(&decoders[0]); // the calling thread is worker 0
+		for (t = 0; t < Int(workers.size()); t++)
+			workers[t].join();
+		Py_END_ALLOW_THREADS;
+	}
+};
+
+static PyObject *batchresults(DecodeBatch &batch)
+{ // what decode_batch and decode_batch_packed return
+	return NRpyTuple(
+		NRpyObject(batch.errcode),
+		NRpyObject(batch.plaintext),
+		NRpyObject(batch.nhypo),
+		NRpyObject(batch.score),
+		NRpyObject(batch.offset),
+		NRpyObject(batch.seq),
+		NRpyObject(batch.nbytes),
+		NULL);
+}
+
+static PyObject *decode_batch(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nthreads = 0, beamwidth = 0;
+	MatUchar qualities;
+	if (args.size() < 2 || args.size() > 5)
+	{
+		NRpyException("decode_batch takes 2 to 5 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("decode_batch requires array with dtype=uint8 \n");
+	MatUchar codetexts(args[0]);
+	Int nmessbits = NRpyInt(args[1]);
+	if (args.size() > 2)
+		nthreads = NRpyInt(args[2]);
+	if (args.size() > 3)
+		beamwidth = NRpyInt(args[3]);
+	if (args.size() > 4 && args[4] != Py_None)
+	{
+		if (PyArray_TYPE(args[4]) != PyArray_UBYTE)
+			NRpyException("decode_batch requires array with dtype=uint8 \n");
+		qualities.initpymat(args[4]);
+		if (qualities.nrows() != codetexts.nrows() || qualities.ncols() < codetexts.ncols())
+		{
+			NRpyException("decode_batch: quality matrix must match the dna matrix");
+			return NRpyObject(0);
+		}
+	}
+	if (codetexts.ncols() > MAXSEQ)
+	{ // checked here, because the worker threads can't report errors to Python
+		NRpyException("decode_batch: MAXSEQ too small");
+		return NRpyObject(0);
+	}
+	if (searchproblem(LAZY, HLIMIT, DPBAND, DPKEEP) != NULL)
+	{ // ditto (setparams and setsearchoptions don't allow this, but the decoders would refuse every row)
+		NRpyException(searchproblem(LAZY, HLIMIT, DPBAND, DPKEEP));
+		return NRpyObject(0);
+	}
+	if (nmessbits > maxmessbits())
+	{ // ditto
+		NRpyException("decode_batch: MAXSEQ too small for nmessbits");
+		return NRpyObject(0);
+	}
+	DecodeBatch batch(codetexts, nmessbits, beamwidth);
+	if (qualities.nrows() > 0)
+		batch.qualities = &qualities;
+	batch.run(defaultnthreads(nthreads, batch.nrows));
+	return batchresults(batch);
+}
+
+static PyObject *decode_batch_packed(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nthreads = 0, beamwidth = 0;
+	if (args.size() < 3 || args.size() > 5)
 	{
-		nmessbits = NRpyInt(args[1]);
+		NRpyException("decode_batch_packed takes 3 to 5 arguments");
+		return NRpyObject(0);
 	}
-	else
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("decode_batch_packed requires array with dtype=uint8 \n");
+	MatUchar codetexts(args[0]);
+	Int nbases = NRpyInt(args[1]);
+	Int nmessbits = NRpyInt(args[2]);
+	if (args.size() > 3)
+		nthreads = NRpyInt(args[3]);
+	if (args.size() > 4)
+		beamwidth = NRpyInt(args[4]);
+	if (nbases < 1 || DNAPacker::nbytes(nbases) > codetexts.ncols())
 	{
-		NRpyException("decode takes 1 or 2 arguments only");
-		return NRpyObject(0); // formerly NULL
+		NRpyException("decode_batch_packed: packed rows too short for nbases");
+		return NRpyObject(0);
+	}
+	if (nbases > MAXSEQ)
+	{ // checked here, because the worker threads can't report errors to Python
+		NRpyException("decode_batch_packed: MAXSEQ too small");
+		return NRpyObject(0);
+	}
+	if (searchproblem(LAZY, HLIMIT, DPBAND, DPKEEP) != NULL)
+	{ // ditto (setparams and setsearchoptions don't allow this, but the decoders would refuse every row)
+		NRpyException(searchproblem(LAZY, HLIMIT, DPBAND, DPKEEP));
+		return NRpyObject(0);
+	}
+	if (nmessbits > maxmessbits())
+	{ // ditto
+		NRpyException("decode_batch_packed: MAXSEQ too small for nmessbits");
+		return NRpyObject(0);
+	}
+	DecodeBatch batch(codetexts, nmessbits, beamwidth, nbases);
+	batch.run(defaultnthreads(nthreads, batch.nrows));
+	return batchresults(batch);
+}
+
+static PyObject *cluster_consensus(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int nthreads = 0;
+	Doub minsimilarity = 0.08;
+	if (args.size() < 1 || args.size() > 3)
+	{
+		NRpyException("cluster_consensus takes 1 to 3 arguments");
+		return NRpyObject(0);
 	}
 	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
-		NRpyException("decode requires array with dtype=uint8 \n");
+		NRpyException("cluster_consensus requires array with dtype=uint8 \n");
+	MatUchar reads(args[0]);
+	if (args.size() > 1)
+		minsimilarity = NRpyDoub(args[1]);
+	if (args.size() > 2)
+		nthreads = NRpyInt(args[2]);
+	if (reads.ncols() - LPRIMER - RPRIMER < ReadClusterer::K + 2 * ReadClusterer::SLACK)
+	{
+		NRpyException("cluster_consensus: reads too short between the primers");
+		return NRpyObject(0);
+	}
+	ReadClusterer rc(reads, LPRIMER, RPRIMER); // primers are the same in every read, so not sketched
+	nthreads = defaultnthreads(nthreads, reads.nrows());
+	Py_BEGIN_ALLOW_THREADS;
+	rc.sketchall(nthreads);
+	Py_END_ALLOW_THREADS;
+	rc.group(minsimilarity); // with the GIL, as it sizes the outputs
+	Py_BEGIN_ALLOW_THREADS;
+	rc.consenseall(nthreads);
+	Py_END_ALLOW_THREADS;
+	return NRpyTuple(
+		NRpyObject(rc.clusterid),
+		NRpyObject(rc.consensus),
+		NRpyObject(rc.clustersize),
+		NRpyObject(rc.consensuslen),
+		NULL);
+}
+
+struct PeekBatch
+{
+	// peekid_C every row of a matrix of raw reads, threaded as DecodeBatch
+	MatUchar &codetexts;
+	Int nrows, budget;
+	atomic<Int> nextrow;
+	VecInt errcode, packet, index; // outputs, one per row
+	VecDoub margin;
+
+	PeekBatch(MatUchar &codetextsin, Int budgetin) : codetexts(codetextsin), nrows(codetextsin.nrows()),
+		budget(budgetin), nextrow(0), errcode(nrows, 0), packet(nrows, 0), index(nrows, 0), margin(nrows, 0.) {}
+	void work(HedgesDecoder *dc)
+	{
+		Int i;
+		while ((i = nextrow++) < nrows)
+		{
+			peekid_C(*dc, codetexts[i], codetexts.ncols(), budget);
+			errcode[i] = dc->errcode;
+			margin[i] = dc->margin;
+			splitid(dc->plaintext, packet[i], index[i]);
+		}
+	}
+	void run(Int nthreads)
+	{
+		Int t;
+		vector<HedgesDecoder> decoders(nthreads);
+		vector<thread> workers;
+		Py_BEGIN_ALLOW_THREADS;
+		for (t = 1; t < nthreads; t++)
+			workers.push_back(thread(&PeekBatch::work, this, &decoders[t]));
+		work(&decoders[0]);
+		for (t = 0; t < Int(workers.size()); t++)
+			workers[t].join();
+		Py_END_ALLOW_THREADS;
+	}
+};
+
+static PyObject *peekid(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int budget = 5000, packet, index;
+	if (args.size() < 1 || args.size() > 2)
+	{
+		NRpyException("peekid takes 1 or 2 arguments only");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("peekid requires array with dtype=uint8 \n");
 	GF4word codetext(args[0]);
-	VecUchar plaintext = decode_C(codetext, nmessbits);
+	if (args.size() > 1)
+		budget = NRpyInt(args[1]);
+	if (searchproblem(LAZY, budget, 0, DPKEEP) != NULL)
+	{ // the budget is the HLIMIT of a best-first search
+		NRpyException("peekid: budget must be below 2^27 with LAZY");
+		return NRpyObject(0);
+	}
+	if (NSALT > 63)
+	{ // the ID is compared as one word (see HedgesDecoder::pathbits)
+		NRpyException("peekid: NSALT must be at most 63");
+		return NRpyObject(0);
+	}
+	decoder.loadsettings();
+	peekid_C(decoder, &codetext[0], codetext.size(), budget);
+	splitid(decoder.plaintext, packet, index);
 	return NRpyTuple(
-		NRpyObject(errcode),
-		NRpyObject(plaintext),
-		NRpyObject(nhypo),
-		NRpyObject(finalscore),
-		NRpyObject(finaloffset),
-		NRpyObject(finalseq),
+		NRpyObject(decoder.errcode),
+		NRpyObject(packet),
+		NRpyObject(index),
+		NRpyObject(decoder.margin),
+		NULL);
+}
+
+static PyObject *peekid_batch(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int budget = 5000, nthreads = 0;
+	if (args.size() < 1 || args.size() > 3)
+	{
+		NRpyException("peekid_batch takes 1 to 3 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("peekid_batch requires array with dtype=uint8 \n");
+	MatUchar codetexts(args[0]);
+	if (args.size() > 1)
+		budget = NRpyInt(args[1]);
+	if (args.size() > 2)
+		nthreads = NRpyInt(args[2]);
+	if (codetexts.ncols() > MAXSEQ)
+	{ // checked here, because the worker threads can't report errors to Python
+		NRpyException("peekid_batch: MAXSEQ too small");
+		return NRpyObject(0);
+	}
+	if (searchproblem(LAZY, budget, 0, DPKEEP) != NULL)
+	{ // ditto, the budget being the HLIMIT of a best-first search
+		NRpyException("peekid_batch: budget must be below 2^27 with LAZY");
+		return NRpyObject(0);
+	}
+	if (NSALT > 63)
+	{ // ditto, as in peekid
+		NRpyException("peekid_batch: NSALT must be at most 63");
+		return NRpyObject(0);
+	}
+	if (NSALT + 16 > maxmessbits())
+	{ // ditto (16 bits of lookahead, as in peekid_C)
+		NRpyException("peekid_batch: MAXSEQ too small");
+		return NRpyObject(0);
+	}
+	PeekBatch batch(codetexts, budget);
+	batch.run(defaultnthreads(nthreads, batch.nrows));
+	return NRpyTuple(
+		NRpyObject(batch.errcode),
+		NRpyObject(batch.packet),
+		NRpyObject(batch.index),
+		NRpyObject(batch.margin),
 		NULL);
 }
 
@@ -924,8 +2895,8 @@ static PyObject *decode_fulldata(PyObject *self, PyObject *pyargs)
 		t_allsalt(allsalt), t_allnewsalt(allnewsalt), t_allnhypo(allnhypo);
 	VecDoub t_allscore(allscore);
 	return NRpyTuple(
-		NRpyObject(errcode),
-		NRpyObject(nhypo),
+		NRpyObject(decoder.errcode),
+		NRpyObject(decoder.nhypo),
 		NRpyObject(t_allmessagebit), // must return a temp, because Python gets control of its contents!
 		NRpyObject(t_allseq),
 		NRpyObject(t_alloffset),
@@ -964,10 +2935,79 @@ static PyObject *revcomp(PyObject *self, PyObject *pyargs)
 	return NRpyObject(0);
 }
 
+static PyObject *packdna(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int i;
+	if (args.size() != 1)
+	{
+		NRpyException("packdna takes exactly 1 argument");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("packdna requires array with dtype=uint8 \n");
+	GF4word dna(args[0]);
+	for (i = 0; i < dna.size(); i++)
+		if (dna[i] > 3)
+		{
+			NRpyException("packdna: only bases 0..3 (ACGT) can be packed");
+			return NRpyObject(0);
+		}
+	VecUchar packed(MAX(1, DNAPacker::nbytes(dna.size())), Uchar(0));
+	if (dna.size() > 0)
+		dnapacker.pack(&dna[0], &packed[0], dna.size());
+	return NRpyObject(packed);
+}
+
+static PyObject *unpackdna(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 2)
+	{
+		NRpyException("unpackdna takes exactly 2 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("unpackdna requires array with dtype=uint8 \n");
+	VecUchar packed(args[0]);
+	Int nbases = NRpyInt(args[1]);
+	if (nbases < 1 || DNAPacker::nbytes(nbases) > packed.size())
+	{
+		NRpyException("unpackdna: packed array too short for nbases");
+		return NRpyObject(0);
+	}
+	GF4word dna(nbases);
+	dnapacker.unpack(&packed[0], &dna[0], nbases);
+	return NRpyObject(dna);
+}
+
+static PyObject *revcomp_packed(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 2)
+	{
+		NRpyException("revcomp_packed takes exactly 2 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("revcomp_packed requires array with dtype=uint8 \n");
+	VecUchar packed(args[0]);
+	Int nbases = NRpyInt(args[1]);
+	if (nbases < 1 || DNAPacker::nbytes(nbases) > packed.size())
+	{
+		NRpyException("revcomp_packed: packed array too short for nbases");
+		return NRpyObject(0);
+	}
+	DNAPacker::revcomp(&packed[0], nbases);
+	return NRpyObject(0);
+}
+
 VecInt gethowfar(Int hlimit, Int maxseq, GF4word &codetext, const char *leftpr, const char *rightpr)
 {
 	VecInt ans(7, 0); // pattern 0 is not defined
 	Int HLIMIT_save = HLIMIT, MAXSEQ_save = MAXSEQ, pattno_save = lastpattnumber;
+	VecUchar pattrn_save(pattrn);
+	Doub reward_save = reward;
 	HLIMIT = hlimit; // change the globals
 	MAXSEQ = maxseq;
 	VecUchar dc;
@@ -975,15 +3015,98 @@ VecInt gethowfar(Int hlimit, Int maxseq, GF4word &codetext, const char *leftpr,
 	{
 		setcoderate_C(ipatt, leftpr, rightpr);
 		dc = decode_C(codetext);
-		ans[ipatt] = finaloffset;
+		ans[ipatt] = decoder.finaloffset;
 	}
 	HLIMIT = HLIMIT_save; // restore the globals
 	MAXSEQ = MAXSEQ_save;
 	lastpattnumber = pattno_save;
-	setcoderate_C(lastpattnumber, leftpr, rightpr);
+	setpattern_C(pattrn_save, reward_save, leftpr, rightpr); // a custom pattern too
 	return ans;
 }
 
+struct RateRace
+{
+	// decode one read at each of the six standard code rates at once, each in its own decoder context,
+	// without touching the globals. A read decodes quickly only at its own rate, so as soon as one rate
+	// finishes, the others give up once they have made as many moves as it needed. Each rate's offset
+	// is then the farthest it got in that many moves, whichever thread happened to run first. The right
+	// primer is left off the read: no rate decodes it well, and searching it is most of the work.
+	static const Int NRATE = 6;
+	GF4word &codetext;
+	Int len; // of the read less its right primer, which no rate decodes well
+	vector<HedgesDecoder> decoders;
+	atomic<Int> nextrate, stopat;
+	// outputs
+	Int rate;		// the winner, 1..6
+	Doub confidence; // 1 less the fraction of the winner's offset that any other rate reached: 0 if a tie
+	VecInt offsets;	 // offsets[i] as gethowfar for rate i, but within len and counting moves only up to stopat
+
+	RateRace(GF4word &codetextin, Int hlimit, Int maxseq, const char *leftpr, const char *rightpr) : codetext(codetextin),
+		len(MAX(1, codetextin.size() - Int(strlen(rightpr)))), decoders(NRATE), nextrate(0),
+		stopat(numeric_limits<Int>::max()), rate(0), confidence(0.), offsets(NRATE + 1, 0)
+	{
+		for (Int r = 0; r < NRATE; r++)
+		{
+			HedgesDecoder &dc = decoders[r];
+			dc.HLIMIT = hlimit;
+			dc.MAXSEQ = maxseq;
+			dc.DPBAND = 0; // best-first search, which only a wrong rate makes slow
+			dc.setcoderate(r + 1, leftpr, rightpr);
+			dc.stopat = &stopat;
+		}
+	}
+	void work()
+	{
+		Int r, m;
+		while ((r = nextrate++) < NRATE)
+		{
+			HedgesDecoder &dc = decoders[r];
+			decode_C(dc, &codetext[0], len);
+			m = stopat;
+			while (finished(r) && dc.nexpanded < m && !stopat.compare_exchange_weak(m, dc.nexpanded))
+				; // m reloaded on failure
+		}
+	}
+	bool finished(Int r)
+	{ // got to the end of the read (errcode is 0 too if the queue ran dry)
+		return decoders[r].errcode == 0 && decoders[r].finaloffset >= len - 1;
+	}
+	Int offsetat(Int r, Int moves)
+	{ // farthest offset decoder r reached within moves
+		Int o, never = numeric_limits<Int>::max();
+		for (o = Int(decoders[r].reachedat.size()) - 1; o >= 0; o--)
+			if (decoders[r].reachedat[o] <= moves && decoders[r].reachedat[o] != never)
+				return o;
+		return -1;
+	}
+	void run(Int nthreads)
+	{ // fewer threads than rates run some rates after others, which then stop sooner
+		Int t, r, second = -1;
+		vector<thread> workers;
+		Py_BEGIN_ALLOW_THREADS;
+		for (t = 1; t < nthreads; t++)
+			workers.push_back(thread(&RateRace::work, this));
+		work();
+		for (t = 0; t < Int(workers.size()); t++)
+			workers[t].join();
+		Py_END_ALLOW_THREADS;
+		for (r = 0; r < NRATE; r++)
+		{ // fewest moves to finish wins, else farthest offset; ties to the lower number
+			offsets[r + 1] = offsetat(r, stopat);
+			if (finished(r) && decoders[r].nexpanded == stopat && rate == 0)
+				rate = r + 1;
+		}
+		if (rate == 0)
+			for (r = 1; r <= NRATE; r++)
+				if (rate == 0 || offsets[r] > offsets[rate])
+					rate = r;
+		for (r = 1; r <= NRATE; r++)
+			if (r != rate)
+				second = MAX(second, offsets[r]);
+		confidence = 1. - Doub(second + 1) / Doub(offsets[rate] + 1);
+	}
+};
+
 static PyObject *tryallcoderates(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
@@ -1003,37 +3126,62 @@ static PyObject *tryallcoderates(PyObject *self, PyObject *pyargs)
 	return NRpyObject(maxoffsets);
 }
 
-static PyObject *createerrors(PyObject *self, PyObject *pyargs)
+static PyObject *detectcoderate(PyObject *self, PyObject *pyargs)
 {
 	NRpyArgs args(pyargs);
-	if (args.size() != 4)
+	Int nthreads = RateRace::NRATE;
+	if (args.size() < 5 || args.size() > 6)
 	{
-		NRpyException("createerrors takes exactly 4 arguments");
-		return NRpyObject(0); // formerly NULL
+		NRpyException("detectcoderate takes 5 or 6 arguments");
+		return NRpyObject(0);
 	}
-	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
-		NRpyException("createrrors requires array with dtype=uint8 \n");
-	GF4word codetext(args[0]);
-	Doub srate = NRpyDoub(args[1]);
-	Doub drate = NRpyDoub(args[2]);
-	Doub irate = NRpyDoub(args[3]);
+	Int hlimit = NRpyInt(args[0]);
+	Int maxseq = NRpyInt(args[1]);
+	if (PyArray_TYPE(args[2]) != PyArray_UBYTE)
+		NRpyException("detectcoderate requires array with dtype=uint8 \n");
+	GF4word codetext(args[2]);
+	const char *leftpr = NRpyCharP(args[3]);
+	const char *rightpr = NRpyCharP(args[4]);
+	if (args.size() > 5)
+		nthreads = NRpyInt(args[5]);
+	if (codetext.size() < 1 || codetext.size() > maxseq)
+	{ // checked here, because the worker threads can't report errors to Python
+		NRpyException("detectcoderate: read empty or longer than maxseq");
+		return NRpyObject(0);
+	}
+	if (LAZY && hlimit >= (1 << 27))
+	{ // ditto
+		NRpyException("detectcoderate: hlimit too large for lazy");
+		return NRpyObject(0);
+	}
+	RateRace race(codetext, hlimit, maxseq, leftpr, rightpr);
+	race.run(defaultnthreads(nthreads, RateRace::NRATE));
+	return NRpyTuple(
+		NRpyObject(race.rate),
+		NRpyObject(race.confidence),
+		NRpyObject(race.offsets),
+		NULL);
+}
+
+GF4word createerrors_C(GF4word &codetext, Doub srate, Doub drate, Doub irate, Ran &rng)
+{ // the error model: at each base an insertion, else a deletion, else maybe a substitution
 	Int n = 0, nn = codetext.size(), k = 0;
 	GF4word ans(2 * nn); // overkill
 	while (n < nn)
 	{
-		if (ran.doub() < irate)
+		if (rng.doub() < irate)
 		{ // insertion
-			ans[k++] = ran.int32() % 4;
+			ans[k++] = rng.int32() % 4;
 			continue;
 		}
-		if (ran.doub() < drate)
+		if (rng.doub() < drate)
 		{ // deletion
 			++n;
 			continue;
 		}
-		if (ran.doub() < srate)
+		if (rng.doub() < srate)
 		{ // substitution or errorfree
-			ans[k++] = (codetext[n++] + (ran.int32() % 3) + 1) % 4;
+			ans[k++] = (codetext[n++] + (rng.int32() % 3) + 1) % 4;
 		}
 		else
 		{
@@ -1041,46 +3189,315 @@ static PyObject *createerrors(PyObject *self, PyObject *pyargs)
 		}
 	}
 	ans.resize(k, true);
+	return ans;
+}
+
+static PyObject *createerrors(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 4)
+	{
+		NRpyException("createerrors takes exactly 4 arguments");
+		return NRpyObject(0); // formerly NULL
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("createrrors requires array with dtype=uint8 \n");
+	GF4word codetext(args[0]);
+	Doub srate = NRpyDoub(args[1]);
+	Doub drate = NRpyDoub(args[2]);
+	Doub irate = NRpyDoub(args[3]);
+	GF4word ans = createerrors_C(codetext, srate, drate, irate, ran);
 	return NRpyObject(ans);
 }
 
-Doub primerscore(const char *ain, GF4word &bin, Int binlen)
-{
-	// returns penalty of match (large is bad)
-	Int i, j;
-	Doub dn, rt, dg;
-	Doub mispen = 1., gappen = 1., skwpen = 1.;
-	char ACGT[] = "ACGT";
-	Int ia = Int(strlen(ain)), ib = binlen;
-	MatDoub cost(ia + 1, ib + 1);
-	cost[0][0] = 0.;
-	for (i = 1; i <= ia; i++)
-		cost[i][0] = cost[i - 1][0] + skwpen;
-	for (i = 1; i <= ib; i++)
-		cost[0][i] = cost[0][i - 1] + skwpen;
-	for (i = 1; i <= ia; i++)
-		for (j = 1; j <= ib; j++)
+static PyObject *setseed(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 1)
+	{
+		NRpyException("setseed takes exactly 1 argument");
+		return NRpyObject(Int(1));
+	}
+	RANSEED = Ullong(NRpyInt(args[0]));
+	ran = (RANSEED != 0 ? Ran(streamseed(RANSEED, 0)) : Ran()); // substream 0 for createerrors (NRpyRS has 1)
+	return NRpyObject(Int(0));
+}
+
+struct RewardCalibration
+{
+	// choose the reward for the current pattern (as set in the globals) by simulation. Random messages
+	// are encoded into strands, given errors by createerrors_C, and decoded at each candidate reward,
+	// one candidate at a time per worker thread, each with its own decoder context. A reward costs the
+	// moves its decodes make, a wrong or failed decode counting as hlimit moves; a candidate stops as
+	// soon as it costs more than the best so far. Every candidate decodes the same reads, made from seed.
+	static const Int NCOARSE = 13; // candidates in the coarse sweep, 0.05 apart
+	Int nbytes, hlimit;
+	vector<GF4word> reads;
+	vector<VecUchar> messages;
+	vector<Doub> candidates;
+	vector<Llong> costs; // of each candidate, or more than bestcost if it was stopped
+	atomic<Int> next;
+	atomic<Llong> bestcost;
+	// output
+	Doub bestreward;
+
+	RewardCalibration(Int strandlen, Int nstrands, Doub srate, Doub drate, Doub irate, Int hlimitin, Ullong seed) :
+		nbytes(0), hlimit(hlimitin), next(0), bestcost(numeric_limits<Llong>::max()), bestreward(reward)
+	{
+		Int i, k;
+		Ran rng(seed);
+		for (k = 0; k < strandlen - RPRIMER; k++)
+			nbytes += pattarr[k]; // message bits that fit in the strand
+		nbytes /= 8;
+		for (i = 0; i < nstrands && nbytes > 0; i++)
+		{
+			VecUchar message(nbytes);
+			for (k = 0; k < nbytes; k++)
+				message[k] = Uchar(rng.int32());
+			GF4word codetext = encode_C(message, strandlen);
+			messages.push_back(message);
+			reads.push_back(createerrors_C(codetext, srate, drate, irate, rng));
+		}
+	}
+	Llong cost(HedgesDecoder &dc, Doub rew)
+	{
+		Int i, k;
+		Llong total = 0, best;
+		dc.reward = rew;
+		for (i = 0; i < Int(reads.size()) && total <= bestcost; i++)
+		{
+			decode_C(dc, reads[i], 8 * nbytes);
+			for (k = 0; k < nbytes && dc.errcode == 0 && k < Int(dc.plaintext.size()) && dc.plaintext[k] == messages[i][k]; k++)
+				;
+			total += (k == nbytes ? dc.nexpanded : hlimit);
+		}
+		best = bestcost;
+		while (total < best && !bestcost.compare_exchange_weak(best, total))
+			; // best reloaded on failure
+		return total;
+	}
+	void work(HedgesDecoder *dc)
+	{
+		Int c;
+		while ((c = next++) < Int(candidates.size()))
+			costs[c] = cost(*dc, candidates[c]);
+	}
+	void sweep(vector<HedgesDecoder> &decoders, Doub from, Doub to, Doub step)
+	{ // candidates from..to (but none above 0); ties go to the first, so the result is the same for any nthreads
+		Int c, t;
+		vector<thread> workers;
+		candidates.clear();
+		for (c = 0; from + c * step <= MIN(to, 0.) + 1.e-9; c++)
+			candidates.push_back(from + c * step);
+		costs.assign(candidates.size(), 0);
+		next = 0;
+		Py_BEGIN_ALLOW_THREADS;
+		for (t = 1; t < Int(decoders.size()); t++)
+			workers.push_back(thread(&RewardCalibration::work, this, &decoders[t]));
+		work(&decoders[0]); // the calling thread is worker 0
+		for (t = 0; t < Int(workers.size()); t++)
+			workers[t].join();
+		Py_END_ALLOW_THREADS;
+		for (c = 0; c < Int(candidates.size()); c++)
+			if (costs[c] == bestcost)
+			{
+				bestreward = candidates[c];
+				break;
+			}
+	}
+	void run(Int nthreads)
+	{ // coarsely over the rewards that make sense, then finely around the best of those
+		Int t;
+		vector<HedgesDecoder> decoders(nthreads); // each takes a snapshot of the global settings
+		for (t = 0; t < nthreads; t++)
+			decoders[t].HLIMIT = hlimit;
+		sweep(decoders, -0.05 * (NCOARSE - 1), 0., 0.05);
+		sweep(decoders, bestreward - 0.04, bestreward + 0.04, 0.01);
+	}
+};
+
+const char *calibrationproblem(Int strandlen, Int hlimit)
+{ // why RewardCalibration can't run with these, or NULL if it can (checked first, as worker threads can't report errors)
+	Int k, nbits = 0;
+	if (strandlen <= LPRIMER + RPRIMER || strandlen > MAXSEQ)
+		return "calibratereward: strandlen too short for the primers, or longer than MAXSEQ";
+	if (LAZY && hlimit >= (1 << 27))
+		return "calibratereward: hlimit too large for lazy";
+	for (k = 0; k < strandlen - RPRIMER; k++)
+		nbits += pattarr[k];
+	if (nbits < 8)
+		return "calibratereward: no whole message byte fits in strandlen";
+	return NULL;
+}
+
+Doub calibratereward_C(Int strandlen, Int nstrands, Doub srate, Doub drate, Doub irate, Int hlimit, Int nthreads)
+{ // sets the global reward for the current pattern, and returns it
+	RewardCalibration calib(strandlen, MAX(1, nstrands), srate, drate, irate, hlimit, 0x7ac1b3a9ULL);
+	calib.run(defaultnthreads(nthreads, RewardCalibration::NCOARSE));
+	reward = calib.bestreward;
+	return reward;
+}
+
+static PyObject *calibratereward(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int strandlen = 300, nstrands = 100, hlimit = 100000, nthreads = 0;
+	Doub srate = 0.0238, drate = 0.0082, irate = 0.0039; // as observed in real DNA data
+	if (args.size() > 7)
+	{
+		NRpyException("calibratereward takes at most 7 arguments");
+		return NRpyObject(0);
+	}
+	if (args.size() > 0)
+		strandlen = NRpyInt(args[0]);
+	if (args.size() > 1)
+		nstrands = NRpyInt(args[1]);
+	if (args.size() > 2)
+		srate = NRpyDoub(args[2]);
+	if (args.size() > 3)
+		drate = NRpyDoub(args[3]);
+	if (args.size() > 4)
+		irate = NRpyDoub(args[4]);
+	if (args.size() > 5)
+		hlimit = NRpyInt(args[5]);
+	if (args.size() > 6)
+		nthreads = NRpyInt(args[6]);
+	const char *problem = calibrationproblem(strandlen, hlimit);
+	if (problem != NULL)
+	{
+		NRpyException(problem);
+		return NRpyObject(0);
+	}
+	return NRpyObject(calibratereward_C(strandlen, nstrands, srate, drate, irate, hlimit, nthreads));
+}
+
+static PyObject *setcustomcoderate(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	Int i, nbits = 0;
+	if (args.size() < 3 || args.size() > 4)
+	{
+		NRpyException("setcustomcoderate takes 3 or 4 arguments");
+		return NRpyObject(0);
+	}
+	if (PyArray_TYPE(args[0]) != PyArray_UBYTE)
+		NRpyException("setcustomcoderate requires pattern array with dtype=uint8 \n");
+	VecUchar patt(args[0]);
+	for (i = 0; i < patt.size(); i++)
+	{
+		if (patt[i] > 2)
+		{
+			NRpyException("setcustomcoderate: pattern entries must be 0, 1, or 2");
+			return NRpyObject(0);
+		}
+		nbits += patt[i];
+	}
+	if (nbits == 0)
+	{
+		NRpyException("setcustomcoderate: pattern must carry at least one bit");
+		return NRpyObject(0);
+	}
+	const char *leftpr = NRpyCharP(args[1]);
+	const char *rightpr = NRpyCharP(args[2]);
+	setpattern_C(patt, args.size() > 3 ? NRpyDoub(args[3]) : reward, leftpr, rightpr);
+	lastpattnumber = PATTERN; // 0 if not a standard pattern
+	if (args.size() > 3)
+		return NRpyObject(reward);
+	const char *problem = calibrationproblem(300, 100000);
+	if (problem != NULL)
+	{
+		NRpyException(problem);
+		return NRpyObject(0);
+	}
+	calibratereward_C(300, 100, 0.0238, 0.0082, 0.0039, 100000, 0);
+	return NRpyObject(reward);
+}
+
+inline void editcolumn(Ullong eq, Ullong &pv, Ullong &mv, Int &dist, Ullong lastbit)
+{
+	// advance the edit distance DP by one char of text, with one bit per char of pattern: pv and mv
+	// flag +1 and -1 steps down a column, eq the pattern chars equal to this text char, and dist
+	// follows the last row (Myers' algorithm, in Hyyro's formulation)
+	Ullong xv = eq | mv, xh = (((eq & pv) + pv) ^ pv) | eq;
+	Ullong ph = mv | ~(xh | pv), mh = pv & xh;
+	if (ph & lastbit)
+		dist++;
+	else if (mh & lastbit)
+		dist--;
+	ph = (ph << 1) | 1; // the top row steps up by one: the alignment is global, not free at the start
+	mh <<= 1;
+	pv = mh | ~(xv | ph);
+	mv = ph & xv;
+}
+
+Int editdistance(const VecUchar &a, const VecUchar &b)
+{ // plain DP, one row at a time, for primers too long for editcolumn
+	Int i, j, diag, up, na = a.size(), nb = b.size();
+	VecInt row(na + 1);
+	for (i = 0; i <= na; i++)
+		row[i] = i;
+	for (j = 1; j <= nb; j++)
+	{
+		diag = row[0];
+		row[0] = j;
+		for (i = 1; i <= na; i++)
+		{
+			up = row[i];
+			row[i] = MIN(MIN(up, row[i - 1]) + 1, diag + (a[i - 1] == b[j - 1] ? 0 : 1));
+			diag = up;
+		}
+	}
+	return row[na];
+}
+
+void primerdistances(const char *primer, GF4word &codeword, Int &fwd, Int &rev)
+{
+	// edit distances of primer from the first chars of codeword, and from the first chars of its
+	// reverse complement, as many of each as the primer is long. Both are found in one pass over
+	// codeword, reading the reverse complement from the far end without making it.
+	Int i, len = Int(strlen(primer)), n = MIN(len, codeword.size()), last = codeword.size() - 1;
+	Uchar c;
+	VecUchar pr(len);
+	for (i = 0; i < len; i++)
+	{ // 4 for anything not ACGT, so that it matches nothing
+		c = Uchar(toupper(primer[i]));
+		pr[i] = (c == 'A' ? 0 : c == 'C' ? 1 : c == 'G' ? 2 : c == 'T' ? 3 : 4);
+	}
+	if (len == 0)
+	{
+		fwd = rev = 0;
+		return;
+	}
+	if (len > 64)
+	{
+		VecUchar ahead(n), behind(n);
+		for (i = 0; i < n; i++)
 		{
-			dn = cost[i - 1][j] + ((j == ib) ? skwpen : gappen);
-			rt = cost[i][j - 1] + ((i == ia) ? skwpen : gappen);
-			dg = cost[i - 1][j - 1] + ((ain[i - 1] == ACGT[bin[j - 1]]) ? -1. : mispen);
-			cost[i][j] = MIN(MIN(dn, rt), dg);
+			ahead[i] = codeword[i];
+			behind[i] = (codeword[last - i] > 3 ? codeword[last - i] : 3 - codeword[last - i]);
 		}
-	return cost[ia][ib];
+		fwd = editdistance(pr, ahead);
+		rev = editdistance(pr, behind);
+		return;
+	}
+	Ullong peq[256] = {0}, pvf = ~0ULL, mvf = 0, pvr = ~0ULL, mvr = 0, lastbit = 1ULL << (len - 1);
+	for (i = 0; i < len; i++)
+		peq[pr[i]] |= 1ULL << i; // peq[4..] stay 0
+	fwd = rev = len;
+	for (i = 0; i < n; i++)
+	{
+		editcolumn(peq[codeword[i]], pvf, mvf, fwd, lastbit);
+		editcolumn(peq[codeword[last - i] > 3 ? codeword[last - i] : 3 - codeword[last - i]], pvr, mvr, rev, lastbit);
+	}
 }
 
 void makesense_C(const char *leftprimer, GF4word &codeword)
 {
 	// reverse complement codeword (in place) if that makes leftprimer agree better
-	Int len = Int(strlen(leftprimer));
-	Doub lscore = primerscore(leftprimer, codeword, len);
-	GF4word rcodeword(codeword);
-	revcomp_C(rcodeword);
-	Doub rscore = primerscore(leftprimer, rcodeword, len);
-	if (rscore <= lscore)
-	{
-		codeword = rcodeword;
-	}
+	Int fwd, rev;
+	primerdistances(leftprimer, codeword, fwd, rev);
+	if (rev <= fwd)
+		revcomp_C(codeword);
 }
 
 static PyObject *makegoodsense(PyObject *self, PyObject *pyargs)
@@ -1119,34 +3536,135 @@ static PyMethodDef NRpyDNAcode_methods[] = {
 	{"setdnaconstraints", setdnaconstraints, METH_VARARGS,
 	 "errorcode = setdnaconstraints(DNAWINDOW, MAXGC, MINGC, MAXRUN)\n set new DNA constraint values\nDNAWINDOW=0 for no constraints"},
 	{"getscores", getscores, METH_VARARGS,
-	 "(reward,substitution,deletion,insertion,dither) = getscores()\n get current scoring parameters"},
+	 "(reward,substitution,deletion,insertion,dither,qualityref) = getscores()\n get current scoring parameters"},
 	{"restorescores", restorescores, METH_VARARGS,
 	 "restorescores()\n restore scoring parameters to default values"},
 	{"setscores", setscores, METH_VARARGS,
-	 "errorcode = setscores(reward,substitution,deletion,insertion,dither)\n set new scoring parameters"},
+	 "errorcode = setscores(reward,substitution,deletion,insertion,dither[,qualityref])\n set new scoring parameters\n\
+	qualityref is the Phred score at and above which a base's quality (if given to decode) changes nothing"},
+	{"getsearchoptions", getsearchoptions, METH_VARARGS,
+	 "(buckets, lazy, strandlen, merge, dpband, dpkeep, primerdp, specialize) = getsearchoptions()\n get current decoder search options"},
+	{"restoresearchoptions", restoresearchoptions, METH_VARARGS,
+	 "restoresearchoptions()\n restore decoder search options to default values"},
+	{"setsearchoptions", setsearchoptions, METH_VARARGS,
+	 "errorcode = setsearchoptions(buckets, lazy, strandlen, merge, dpband, dpkeep, primerdp, specialize)\n set decoder search options\n\
+	buckets=1 uses a bucket queue when dither is 0 and the scores allow, else a heap; it pops equal scores\n\
+	in another order than the heap, so a few decodes can come out differently (hence off by default)\n\
+	lazy=1 queues moves with optimistic scores and builds hypotheses only when popped\n\
+	strandlen>0 is the length strands were written with; the decoder then charges each hypothesis\n\
+	up front for the indels it would still need to end at the read's length, less those that the strand\n\
+	past nmessbits (not searched) could hold; it seldom pays at usual error rates (0 to turn off)\n\
+	merge=1 keeps only the best hypothesis in each state (seq, offset, prevbits, salt, prevcode)\n\
+	dpband>0 decodes by dynamic programming over seq, keeping the dpkeep (>=1) best hypotheses at each offset\n\
+	within dpband of offset==seq, for a fixed amount of work per strand (a beamwidth given to decode wins)\n\
+	primerdp=1 aligns the left primer by dynamic programming and starts best-first search at its end,\n\
+	one hypothesis per offset, instead of searching the primer (not with dither or decode_joint)\n\
+	specialize=1 runs best-first search with code compiled for the code rate and DNA constraints set,\n\
+	0 with the generic code (the same results, more slowly)"},
 	{"setcoderate", setcoderate, METH_VARARGS,
 	 "errorcode = setcoderate(number, leftprimer, rightprimer)\n\
 	 set coderate to one of six values for number=1..6 (0.75, 0.6, 0.5, 0.333, 0.25, 0.166)"},
+	{"setcustomcoderate", setcustomcoderate, METH_VARARGS,
+	 "reward = setcustomcoderate(uint8_pattern, leftprimer, rightprimer[, reward])\n\
+	set a coderate of one's own: the vbits after the left primer carry pattern[i % len(pattern)] bits each\n\
+	(0, 1, or 2), so [2,1,1] is rate 0.667 and [2,1,1,1,1,1,1,0,1,1] rate 0.55; without reward, one is found\n\
+	by calibratereward() with its defaults (which takes a while)"},
+	{"calibratereward", calibratereward, METH_VARARGS,
+	 "reward = calibratereward([strandlen, nstrands, subrate, delrate, insrate, hlimit, nthreads])\n\
+	find the reward that best suits the current coderate, and set it: nstrands (default 100) random messages\n\
+	are encoded in strandlen (300) bases, given errors as by createerrors (default 0.0238, 0.0082, 0.0039),\n\
+	and decoded at rewards from -0.6 to 0, for the fewest moves, a wrong or failed decode counting as hlimit\n\
+	(100000); the error rates should be ones the rate can mostly correct. nthreads=0 for one per core"},
 	{"encode", encode, METH_VARARGS,
 	 "int8_dna_array = encode(int8_message_array [, strandlen])\n encode a message with runout to strandlen"},
 	{"encodestring", encodestring, METH_VARARGS,
 	 "int8_dna_array = encodestring(message_as_string)\n encode a message"},
+	{"encode_packed", encode_packed, METH_VARARGS,
+	 "(packed_array, nbases) = encode_packed(int8_message_array [, strandlen])\n\
+	encode a message, as encode, but return the strand packed 4 bases to a byte (see packdna)"},
+	{"encode_batch", encode_batch, METH_VARARGS,
+	 "int8_dna_matrix = encode_batch(int8_message_matrix, totstrandlen, int8_filler[, int8_dna_matrix[, nthreads]])\n\
+	encode every row in parallel, splicing filler before the right primer to reach totstrandlen;\n\
+	writes into int8_dna_matrix [nstrands, totstrandlen] if supplied (nthreads=0 for one per core)"},
 	{"decode", decode, METH_VARARGS,
-	 "(errcode, int8_message_array, nhypo, score, offset, seq) = decode(int8_dna_array[, nmessbits])\n\
-	decode a message optionally limited to nmessbits message bits"},
+	 "(errcode, int8_message_array, nhypo, score, offset, seq) = decode(int8_dna_array[, nmessbits[, beamwidth[, uint8_quality_array]]])\n\
+	decode a message optionally limited to nmessbits message bits;\n\
+	beamwidth>0 uses a beam search of that width instead of best-first (HLIMIT does not apply);\n\
+	with per-base Phred scores (not ASCII: FASTQ chars less 33), the reward or substitution at each base\n\
+	is scaled down when its score is below qualityref (see setscores).\n\
+	errcode 2 if HLIMIT was reached first, 3 if the settings allow no search (then the message is empty)\n\
+	or the read needs more than MAXSEQ vbits"},
+	{"decode_packed", decode_packed, METH_VARARGS,
+	 "(errcode, int8_message_array, nhypo, score, offset, seq) = decode_packed(packed_array, nbases[, nmessbits[, beamwidth]])\n\
+	decode, as decode, a strand of nbases bases packed 4 to a byte (see packdna)"},
+	{"setdecodecache", setdecodecache, METH_VARARGS,
+	 "errorcode = setdecodecache(nentries)\n\
+	keep the results of up to nentries decodes, so that a read seen again with the same settings is not\n\
+	decoded again (0, the default, turns the cache off); empties the cache and zeroes its counters"},
+	{"getdecodecachestats", getdecodecachestats, METH_VARARGS,
+	 "(hits, misses, nentries, nfilled) = getdecodecachestats()\n\
+	lookups answered from the cache and not, by decode, decode_packed and the batch decodes"},
+	{"decode_joint", decode_joint, METH_VARARGS,
+	 "(errcode, int8_message_array, nhypo, score, offset, seq) = decode_joint(int8_dna_matrix[, nmessbits])\n\
+	decode one message from several reads of the same strand (the rows, zero-padded to one length, e.g. a cluster\n\
+	from cluster_consensus), scoring each hypothesis against all of them at once; offset is in the first read.\n\
+	Best-first search with MERGE always on: beamwidth, DPBAND and LAZY do not apply.  Give nmessbits, so the padding is not decoded"},
+	{"getsearchstats", getsearchstats, METH_VARARGS,
+	 "(nhypo, nexpanded, nmerged) = getsearchstats()\n\
+	hypotheses materialized, moves scored and queued, and hypotheses merged into a better one in the same state,\n\
+	by the last decode (nexpanded = nhypo-1 only for best-first search without lazy or merge)"},
+	{"decode_batch", decode_batch, METH_VARARGS,
+	 "(errcode, int8_message_matrix, nhypo, score, offset, seq, nbytes) = decode_batch(int8_dna_matrix, nmessbits[, nthreads[, beamwidth[, uint8_quality_matrix]]])\n\
+	decode every row of a packet in parallel (nthreads=0 for one per core), one result per row;\n\
+	row i of int8_message_matrix is valid for its first nbytes[i] bytes"},
+	{"encode_batch_packed", encode_batch_packed, METH_VARARGS,
+	 "packed_matrix = encode_batch_packed(int8_message_matrix, totstrandlen, int8_filler[, nthreads])\n\
+	as encode_batch, but row i of packed_matrix is strand i packed 4 bases to a byte (see packdna)"},
+	{"decode_batch_packed", decode_batch_packed, METH_VARARGS,
+	 "(errcode, int8_message_matrix, nhypo, score, offset, seq, nbytes) = decode_batch_packed(packed_matrix, nbases, nmessbits[, nthreads[, beamwidth]])\n\
+	as decode_batch, for rows that each hold a strand of nbases bases packed 4 to a byte"},
+	{"cluster_consensus", cluster_consensus, METH_VARARGS,
+	 "(clusterid, int8_consensus_matrix, clustersize, consensuslen) = cluster_consensus(int8_dna_matrix[, minsimilarity[, nthreads]])\n\
+	group reads (rows) that are likely copies of the same strand, by MinHash sketches of their k-mers between\n\
+	the primers (estimated Jaccard similarity >= minsimilarity, default 0.08), and build each cluster's consensus\n\
+	by aligning its reads to its medoid and voting; decode_batch the consensus matrix to decode each cluster once"},
+	{"peekid", peekid, METH_VARARGS,
+	 "(errcode, packet, index, margin) = peekid(int8_dna_array[, budget])\n\
+	decode only the strand ID, the first NSALT message bits, with a budget of search moves (default 5000):\n\
+	index is the last ID byte, packet the ones before it.  margin is how much worse the best decode with\n\
+	another ID scores, up to 1.5, beyond which it is not looked for: the larger, the surer.  errcode 2 if over budget"},
+	{"peekid_batch", peekid_batch, METH_VARARGS,
+	 "(errcode, packet, index, margin) = peekid_batch(int8_dna_matrix[, budget[, nthreads]])\n\
+	peekid every row in parallel (nthreads=0 for one per core), to route raw reads to packets before decoding"},
 	{"tryallcoderates", tryallcoderates, METH_VARARGS,
 	 "maxoffsets = tryallcoderates(hlimit, maxseq, int8_dna_array, leftprimer, rightprimer)\n\
 	maxoffsets[i] is maximum offset achieved in trying coderate i (in 1..6) limited by hlimit"},
+	{"detectcoderate", detectcoderate, METH_VARARGS,
+	 "(rate, confidence, maxoffsets) = detectcoderate(hlimit, maxseq, int8_dna_array, leftprimer, rightprimer[, nthreads])\n\
+	as tryallcoderates, but the rates race in parallel (nthreads, default 6, one per rate) and leave the globals\n\
+	alone. Once one gets to the right primer, the rest stop when they have made as many moves. rate is the\n\
+	winner, confidence 1 less the fraction of its offset that any other rate reached (0 a tie, near 1 sure)"},
 	{"decode_fulldata", decode_fulldata, METH_VARARGS,
 	 "(errcode,nhypo,messagebit,seq,offset,score,hypo,predi,prevbits,salt,newsalt) =\n\
 	decode_fulldata(codetext[, nmessbits])"},
 	{"createerrors", createerrors, METH_VARARGS,
 	 "new_int8_dna_array = createerrors(int8_dna_array, subrate, delrate, insrate)\n\
 	create Poisson random errors at specified rates"},
+	{"setseed", setseed, METH_VARARGS,
+	 "errorcode = setseed(seed)\n\
+	restart createerrors' random numbers from seed, and give each read its own dither, picked by seed and the\n\
+	read, so that runs and batch decodes repeat exactly whatever the threads do (seed=0 for the clock, as at start)"},
 	{"releaseall", releaseall, METH_VARARGS,
 	 "errcode = releaseall()\n release memory grabbed by decode_fulldata"},
 	{"revcomp", revcomp, METH_VARARGS,
 	 "revcomp(int8_dna_array)\n reverse-complement a dna array in place"},
+	{"packdna", packdna, METH_VARARGS,
+	 "packed_array = packdna(int8_dna_array)\n\
+	pack bases (0..3) 4 to a byte, base i in bits 2*(i%4) of byte i/4: a quarter of the memory"},
+	{"unpackdna", unpackdna, METH_VARARGS,
+	 "int8_dna_array = unpackdna(packed_array, nbases)\n unpack the first nbases bases of a packed strand"},
+	{"revcomp_packed", revcomp_packed, METH_VARARGS,
+	 "revcomp_packed(packed_array, nbases)\n reverse-complement a packed strand of nbases bases in place"},
 	{"makegoodsense", makegoodsense, METH_VARARGS,
 	 "new_int8_dna_array = makegoodsense(leftprimer, int8_dna_array)\n\
 	return array or its reverse-complement, whichever agrees best with leftprimer"},
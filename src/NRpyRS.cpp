@@ -109,6 +109,19 @@ static PyObject *makeerrors(PyObject *self, PyObject *pyargs)
 	return NRpyObject(codeword);
 }
 
+static PyObject *setseed(PyObject *self, PyObject *pyargs)
+{
+	NRpyArgs args(pyargs);
+	if (args.size() != 1)
+	{
+		NRpyException("setseed takes exactly 1 argument");
+		return NRpyObject(Int(1));
+	}
+	Ullong seed = Ullong(NRpyInt(args[0]));
+	ran = (seed != 0 ? Ran(streamseed(seed, 1)) : Ran()); // substream 1 (NRpyDNAcode's createerrors has 0)
+	return NRpyObject(Int(0));
+}
+
 // standard boilerplate
 static PyMethodDef NRpyRS_methods[] = {
 	{"rsencode", rsencode, METH_VARARGS,
@@ -119,6 +132,8 @@ static PyMethodDef NRpyRS_methods[] = {
 	 "(newcodetext,locations) = makeerasures(codetext,nerasures)"},
 	{"makeerrors", makeerrors, METH_VARARGS,
 	 "newcodetext = makeerrors(codetext,nerrors)"},
+	{"setseed", setseed, METH_VARARGS,
+	 "errorcode = setseed(seed)\n restart the random numbers of makeerasures and makeerrors from seed (0 for the clock)"},
 	{NULL, NULL, 0, NULL}};
 PyMODINIT_FUNC initNRpyRS(void)
 {
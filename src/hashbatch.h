@@ -0,0 +1,91 @@
+/* usage:
+RanhashBatch hb;
+hb.int64(u, v, n);  // v[i] = Ranhash().int64(u[i]) for i = 0..n-1, bit for bit
+This hashes n independent inputs at once, 8 to a vector with AVX-512 (F and DQ),
+4 to a vector with AVX2, else one at a time.  The choice is made once, at run time,
+from what the CPU supports, so one binary runs anywhere.  AVX2 has no 64-bit
+multiply, so there each product is built from three 32x32-bit ones.
+*/
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RANHASH_X86 // only here do we know how to ask the CPU and compile for targets
+#endif
+
+struct RanhashBatch
+{
+	static const Ullong C1 = 3935559000370003845ULL, C2 = 2691343689449507681ULL, C3 = 4768777513237032717ULL;
+	typedef void (*Kernel)(const Ullong *u, Ullong *v, Int n);
+	Kernel kernel;
+	const char *kernelname;
+
+	RanhashBatch() { pickkernel(); }
+	inline void int64(const Ullong *u, Ullong *v, Int n) { kernel(u, v, n); }
+	static void scalar(const Ullong *u, Ullong *v, Int n)
+	{
+		Ranhash hash;
+		for (Int i = 0; i < n; i++)
+			v[i] = hash.int64(u[i]);
+	}
+#ifdef RANHASH_X86
+	__attribute__((target("avx2"))) static inline __m256i mul4(__m256i a, Ullong c)
+	{ // low 64 bits of a*c in each lane: alo*clo + ((ahi*clo + alo*chi) << 32)
+		__m256i clo = _mm256_set1_epi64x(Llong(c & 0xffffffffULL)), chi = _mm256_set1_epi64x(Llong(c >> 32));
+		__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), clo), _mm256_mul_epu32(a, chi));
+		return _mm256_add_epi64(_mm256_mul_epu32(a, clo), _mm256_slli_epi64(cross, 32));
+	}
+	__attribute__((target("avx2"))) static void avx2(const Ullong *u, Ullong *v, Int n)
+	{
+		Int i;
+		__m256i x, c2 = _mm256_set1_epi64x(Llong(C2));
+		for (i = 0; i + 4 <= n; i += 4)
+		{ // same steps as Ranhash::int64
+			x = _mm256_add_epi64(mul4(_mm256_loadu_si256((const __m256i *)(u + i)), C1), c2);
+			x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 21));
+			x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 37));
+			x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 4));
+			x = mul4(x, C3);
+			x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 20));
+			x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 41));
+			x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 5));
+			_mm256_storeu_si256((__m256i *)(v + i), x);
+		}
+		scalar(u + i, v + i, n - i);
+	}
+	__attribute__((target("avx512f,avx512dq"))) static void avx512(const Ullong *u, Ullong *v, Int n)
+	{
+		Int i;
+		__m512i x, c1 = _mm512_set1_epi64(Llong(C1)), c2 = _mm512_set1_epi64(Llong(C2)), c3 = _mm512_set1_epi64(Llong(C3));
+		for (i = 0; i + 8 <= n; i += 8)
+		{ // ditto
+			x = _mm512_add_epi64(_mm512_mullo_epi64(_mm512_loadu_si512((const void *)(u + i)), c1), c2);
+			x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 21));
+			x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 37));
+			x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 4));
+			x = _mm512_mullo_epi64(x, c3);
+			x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 20));
+			x = _mm512_xor_si512(x, _mm512_srli_epi64(x, 41));
+			x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 5));
+			_mm512_storeu_si512((void *)(v + i), x);
+		}
+		avx2(u + i, v + i, n - i); // any CPU with AVX-512 has AVX2
+	}
+#endif
+	void pickkernel()
+	{
+		kernel = scalar;
+		kernelname = "scalar";
+#ifdef RANHASH_X86
+		__builtin_cpu_init(); // needed when called before main(), as for a global
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+		{
+			kernel = avx512;
+			kernelname = "avx512";
+		}
+		else if (__builtin_cpu_supports("avx2"))
+		{
+			kernel = avx2;
+			kernelname = "avx2";
+		}
+#endif
+	}
+};
@@ -102,3 +102,280 @@ struct HeapScheduler
 	}
 */
 };
+
+/* usage is the same as HeapScheduler above (push, pop, lastcargo, rewind, reinit),
+so the two are interchangeable wherever the scheduler is a template argument:
+DaryHeapScheduler<Doub,CargoClass,D> myheap;  // D = 4 (default) or 8
+This is a D-ary heap whose times and cargos sit together in one array, so a sift
+moves one node instead of swapping in two arrays, and the D daughters of a node
+share a 64-byte cache line (two for D=8).  rewind() is O(1), because nothing
+beyond the end of the heap is ever read.
+*/
+
+template <class T = Doub, class U = void *, Int D = 4>
+struct DaryHeapScheduler
+{
+	static const Int defaultps = 1100000; // initial heap size
+	struct Node
+	{
+		T time;
+		U cargo;
+	};
+	T bigval;
+	U lastcargo;
+	Int ps, ks;
+	char *mem; // raw storage, over-allocated so that ar can be aligned
+	Node *ar;  // ar[0] is the top; daughters of k are D*k+1 .. D*k+D
+
+	DaryHeapScheduler() : bigval(numeric_limits<T>::max()), ps(0), ks(0), mem(NULL), ar(NULL) { resizear(defaultps); }
+	DaryHeapScheduler(const DaryHeapScheduler &rhs) : bigval(rhs.bigval), ps(0), ks(0), mem(NULL), ar(NULL)
+	{
+		resizear(rhs.ps);
+		ks = rhs.ks;
+		memcpy(ar, rhs.ar, ks * sizeof(Node));
+	}
+	DaryHeapScheduler &operator=(const DaryHeapScheduler &rhs)
+	{
+		if (this != &rhs)
+		{
+			ks = 0;
+			resizear(rhs.ps);
+			ks = rhs.ks;
+			memcpy(ar, rhs.ar, ks * sizeof(Node));
+		}
+		return *this;
+	}
+	~DaryHeapScheduler() { free(mem); }
+	void push(T time, U cargo = U(NULL))
+	{ // lengthen list, add to end, sift up (moving mothers down into the hole)
+		Int k, mo;
+		if (ks == ps)
+			resizear(2 * ps);
+		k = ks++;
+		while (k > 0 && ar[mo = (k - 1) / D].time > time)
+		{
+			ar[k] = ar[mo];
+			k = mo;
+		}
+		ar[k].time = time;
+		ar[k].cargo = cargo;
+	}
+	T pop() { return pop(lastcargo); } // if no argument, return cargo in lastcargo
+	T pop(U &cargo)
+	{ // return top of heap, move last to top, shorten list, sift down
+		// returns numeric_limits::max() time, and U() cargo, when heap is empty
+		Int k = 0, dau, lastdau, mindau;
+		if (ks == 0)
+		{
+			cargo = U();
+			return bigval;
+		}
+		T ans = ar[0].time;
+		cargo = ar[0].cargo;
+		Node last = ar[--ks];
+		while ((dau = D * k + 1) < ks)
+		{
+			lastdau = MIN(dau + D, ks);
+			for (mindau = dau++; dau < lastdau; dau++)
+				if (ar[dau].time < ar[mindau].time)
+					mindau = dau;
+			if (!(ar[mindau].time < last.time))
+				break;
+			ar[k] = ar[mindau]; // move smallest daughter up into the hole
+			k = mindau;
+		}
+		ar[k] = last;
+		return ans;
+	}
+	void resizear(Int newps)
+	{ // only used internally; keeps the contents
+		// ar is offset by D-1 nodes from a 64-byte boundary, so that ar[1], ar[D+1], ... are on one
+		char *newmem = (char *)malloc((newps + D - 1) * sizeof(Node) + 64);
+		Node *newar = (Node *)(newmem + ((64 - size_t(newmem) % 64) % 64)) + (D - 1);
+		if (ks > 0)
+			memcpy(newar, ar, ks * sizeof(Node));
+		free(mem);
+		mem = newmem;
+		ar = newar;
+		ps = newps;
+	}
+	void rewind() { ks = 0; } // empty the heap w/o changing its size in memory
+	void reinit()
+	{ // empty the heap and give back memory
+		ks = 0;
+		if (ps != defaultps)
+			resizear(defaultps);
+	}
+};
+
+inline Int lowestbit(Ullong x)
+{ // index of the lowest set bit of x (x != 0)
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward64(&i, x);
+	return Int(i);
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+/* usage is the same as HeapScheduler, except that times must lie (to within rounding)
+on a lattice of integer multiples of 1/lattice, which must be set before the first push:
+BucketScheduler<CargoClass> myqueue;
+myqueue.setlattice(1000.);  // e.g., all times are multiples of 0.001
+It is a bucket queue with one LIFO list per lattice point in a sliding window, and a
+two-level bitmap of the nonempty buckets to find the smallest.  Push and pop are O(1)
+(pop scans one 64-bit summary word per 4096 buckets between successive minima), and
+rewind() only touches nonempty buckets.  Times need not be monotone.
+*/
+
+template <class U = void *>
+struct BucketScheduler
+{
+	static const Int defaultnb = 65536; // initial number of buckets (a multiple of 4096)
+	static const Int defaultps = 110000; // initial number of nodes (grows as needed)
+	struct Node
+	{
+		Doub time;
+		U cargo;
+		Int next; // next node in the same bucket, or -1
+	};
+	Doub bigval;
+	U lastcargo;
+	Doub lattice; // buckets per unit time
+	Llong lo;	  // lattice index of bucket 0
+	Int nb, ks, cursor, nused, freelist;
+	// (std::vector, not NRvector, which allocates through Python: a decoder may run without the GIL)
+	vector<Int> head;		// first node in each bucket, or -1
+	vector<Ullong> bits;	// one bit per bucket, set if nonempty
+	vector<Ullong> summary; // one bit per word of bits, set if nonzero
+	vector<Node> nodes;
+
+	BucketScheduler() : bigval(numeric_limits<Doub>::max()), lattice(1.), lo(-defaultnb / 2), nb(defaultnb),
+						ks(0), cursor(nb), nused(0), freelist(-1), head(nb, -1), bits(nb / 64, 0ull),
+						summary(nb / 4096, 0ull), nodes(defaultps) {}
+	void setlattice(Doub latt)
+	{ // the bucket width is 1/latt; empties the queue
+		rewind();
+		lattice = latt;
+	}
+	void push(Doub time, U cargo = U(NULL))
+	{
+		Llong b = llround(time * lattice) - lo;
+		Int k;
+		if (b < 0 || b >= nb)
+			b = regrow(b + lo) - lo;
+		if (freelist >= 0)
+		{
+			k = freelist;
+			freelist = nodes[k].next;
+		}
+		else
+		{
+			if (nused == Int(nodes.size()))
+				nodes.resize(2 * nused);
+			k = nused++;
+		}
+		nodes[k].time = time;
+		nodes[k].cargo = cargo;
+		nodes[k].next = head[Int(b)];
+		if (head[Int(b)] < 0)
+			setbit(Int(b));
+		head[Int(b)] = k;
+		if (b < cursor)
+			cursor = Int(b);
+		++ks;
+	}
+	Doub pop() { return pop(lastcargo); } // if no argument, return cargo in lastcargo
+	Doub pop(U &cargo)
+	{ // returns numeric_limits::max() time, and U() cargo, when queue is empty
+		if (ks == 0)
+		{
+			cargo = U();
+			return bigval;
+		}
+		Int b = nextnonempty(cursor), k = head[b];
+		cursor = b;
+		head[b] = nodes[k].next;
+		if (head[b] < 0)
+			clearbit(b);
+		nodes[k].next = freelist;
+		freelist = k;
+		--ks;
+		cargo = nodes[k].cargo;
+		return nodes[k].time;
+	}
+	void rewind()
+	{ // empty the queue w/o changing its size in memory
+		Int s, w, b;
+		for (s = 0; s < Int(summary.size()); s++)
+			while (summary[s])
+			{
+				w = 64 * s + lowestbit(summary[s]);
+				while (bits[w])
+				{
+					b = 64 * w + lowestbit(bits[w]);
+					head[b] = -1;
+					bits[w] &= bits[w] - 1;
+				}
+				summary[s] &= summary[s] - 1;
+			}
+		ks = nused = 0;
+		freelist = -1;
+		cursor = nb;
+	}
+	void reinit()
+	{ // empty the queue and give back memory
+		rewind();
+		vector<Node>(defaultps).swap(nodes); // (resize alone would keep the capacity)
+	}
+
+private:
+	void setbit(Int b)
+	{
+		bits[b >> 6] |= 1ull << (b & 63);
+		summary[b >> 12] |= 1ull << ((b >> 6) & 63);
+	}
+	void clearbit(Int b)
+	{
+		if ((bits[b >> 6] &= ~(1ull << (b & 63))) == 0)
+			summary[b >> 12] &= ~(1ull << ((b >> 6) & 63));
+	}
+	Int nextnonempty(Int b)
+	{ // smallest nonempty bucket >= b (there must be one)
+		Int w = b >> 6, s;
+		Ullong m = bits[w] & (~0ull << (b & 63));
+		if (m)
+			return 64 * w + lowestbit(m);
+		s = (w + 1) >> 6;
+		m = ((w + 1) & 63) ? summary[s] & (~0ull << ((w + 1) & 63)) : summary[s];
+		while (m == 0)
+			m = summary[++s];
+		w = 64 * s + lowestbit(m);
+		return 64 * w + lowestbit(bits[w]);
+	}
+	Llong regrow(Llong idx)
+	{ // widen the window (by a multiple of 4096 buckets) until it covers lattice index idx
+		Llong newlo = lo, newhi = lo + nb;
+		Int i, shift;
+		while (idx < newlo)
+			newlo -= (newhi - newlo);
+		while (idx >= newhi)
+			newhi += (newhi - newlo);
+		shift = Int(lo - newlo);
+		vector<Int> oldhead(head);
+		nb = Int(newhi - newlo);
+		lo = newlo;
+		head.assign(nb, -1);
+		bits.assign(nb / 64, 0ull);
+		summary.assign(nb / 4096, 0ull);
+		for (i = 0; i < Int(oldhead.size()); i++)
+			if ((head[i + shift] = oldhead[i]) >= 0)
+				setbit(i + shift);
+		if (ks > 0)
+			cursor += shift;
+		else
+			cursor = nb;
+		return idx;
+	}
+};
@@ -27,6 +27,13 @@
 #include <iomanip>
 #include <vector>
 #include <limits>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h> // for the vector kernels in hashbatch.h
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
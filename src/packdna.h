@@ -0,0 +1,129 @@
+/* usage:
+DNAPacker pk;
+pk.pack(dna, packed, n);	   // packed[0..(n+3)/4-1] from bases dna[0..n-1], each 0..3 (ACGT)
+pk.unpack(packed, dna, n);	   // the reverse
+DNAPacker::revcomp(packed, n); // reverse complement in place, still packed
+Base i goes in bits 2*(i%4) of byte i/4, and the spare bits of the last byte are 0, so a
+300-nt strand takes 75 bytes.  pack and unpack do 32 bases at a time with AVX2, else 8 at
+a time in a 64-bit word; as in hashbatch.h, the choice is made once, at run time.
+*/
+
+struct DNAPacker
+{
+	typedef void (*Kernel)(const Uchar *in, Uchar *out, Int n);
+	Kernel packer, unpacker;
+	const char *kernelname;
+
+	DNAPacker() { pickkernel(); }
+	inline void pack(const Uchar *dna, Uchar *packed, Int n) { packer(dna, packed, n); }
+	inline void unpack(const Uchar *packed, Uchar *dna, Int n) { unpacker(packed, dna, n); }
+	static inline Int nbytes(Int n) { return (n + 3) >> 2; }
+
+	static void packscalar(const Uchar *dna, Uchar *packed, Int n)
+	{
+		Int i, k;
+		Ullong x;
+		for (i = 0; i + 8 <= n; i += 8)
+		{ // 8 bases, one per byte of x, squeezed into its low 16 bits
+			for (k = 0, x = 0; k < 8; k++)
+				x |= Ullong(dna[i + k]) << (8 * k);
+			x = (x | (x >> 6)) & 0x000F000F000F000FULL;
+			x = (x | (x >> 12)) & 0x000000FF000000FFULL;
+			x = (x | (x >> 24));
+			packed[i >> 2] = Uchar(x);
+			packed[(i >> 2) + 1] = Uchar(x >> 8);
+		}
+		for (; i < n; i++)
+		{
+			if ((i & 3) == 0)
+				packed[i >> 2] = 0;
+			packed[i >> 2] |= Uchar(dna[i] << (2 * (i & 3)));
+		}
+	}
+	static void unpackscalar(const Uchar *packed, Uchar *dna, Int n)
+	{
+		Int i, k;
+		Ullong x;
+		for (i = 0; i + 8 <= n; i += 8)
+		{ // the same steps backward
+			x = Ullong(packed[i >> 2]) | (Ullong(packed[(i >> 2) + 1]) << 8);
+			x = (x | (x << 24)) & 0x000000FF000000FFULL;
+			x = (x | (x << 12)) & 0x000F000F000F000FULL;
+			x = (x | (x << 6)) & 0x0303030303030303ULL;
+			for (k = 0; k < 8; k++)
+				dna[i + k] = Uchar(x >> (8 * k));
+		}
+		for (; i < n; i++)
+			dna[i] = (packed[i >> 2] >> (2 * (i & 3))) & 3;
+	}
+#ifdef RANHASH_X86
+	__attribute__((target("avx2"))) static void packavx2(const Uchar *dna, Uchar *packed, Int n)
+	{
+		Int i;
+		__m256i x;
+		for (i = 0; i + 32 <= n; i += 32)
+		{ // pairs to nibbles, nibbles to bytes (one per 32-bit lane), then gather the bytes
+			x = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(dna + i)), _mm256_set1_epi16(0x0401));
+			x = _mm256_madd_epi16(x, _mm256_set1_epi32(0x00100001));
+			x = _mm256_shuffle_epi8(x, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+														0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+			*(int *)(packed + (i >> 2)) = _mm_cvtsi128_si32(_mm256_castsi256_si128(x));
+			*(int *)(packed + (i >> 2) + 4) = _mm_cvtsi128_si32(_mm256_extracti128_si256(x, 1));
+		}
+		packscalar(dna + i, packed + (i >> 2), n - i);
+	}
+	__attribute__((target("avx2"))) static void unpackavx2(const Uchar *packed, Uchar *dna, Int n)
+	{
+		Int i;
+		Llong w;
+		__m256i x, t;
+		for (i = 0; i + 32 <= n; i += 32)
+		{ // each packed byte to 4 bytes, each masked to its own 2 bits, then those shifted down
+			memcpy(&w, packed + (i >> 2), 8);
+			x = _mm256_shuffle_epi8(_mm256_set1_epi64x(w), _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+																			 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7));
+			x = _mm256_and_si256(x, _mm256_set1_epi32(Int(0xC0300C03)));
+			t = _mm256_or_si256(_mm256_srli_epi16(x, 2), _mm256_srli_epi16(x, 4)); // (16-bit shifts spill
+			t = _mm256_or_si256(t, _mm256_srli_epi16(x, 6));						 // only into bits masked off)
+			_mm256_storeu_si256((__m256i *)(dna + i), _mm256_and_si256(_mm256_or_si256(x, t), _mm256_set1_epi8(3)));
+		}
+		unpackscalar(packed + (i >> 2), dna + i, n - i);
+	}
+#endif
+	static void revcomp(Uchar *packed, Int n)
+	{
+		// reverse the bytes, and the bases in each, and complement them all (A<->T is 0<->3, C<->G
+		// is 1<->2, so just flip the bits); then the padding, now at the front, is shifted out
+		Int i, nb = nbytes(n), pad = 2 * (4 * nb - n);
+		Uchar b;
+		for (i = 0; i < nb / 2; i++)
+			SWAP(packed[i], packed[nb - 1 - i]);
+		for (i = 0; i < nb; i++)
+		{
+			b = packed[i];
+			b = Uchar(((b & 0x33) << 2) | ((b >> 2) & 0x33));
+			packed[i] = Uchar(~((b << 4) | (b >> 4)));
+		}
+		if (pad > 0)
+		{
+			for (i = 0; i < nb - 1; i++)
+				packed[i] = Uchar((packed[i] >> pad) | (packed[i + 1] << (8 - pad)));
+			packed[nb - 1] = Uchar(packed[nb - 1] >> pad);
+		}
+	}
+	void pickkernel()
+	{
+		packer = packscalar;
+		unpacker = unpackscalar;
+		kernelname = "scalar";
+#ifdef RANHASH_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			packer = packavx2;
+			unpacker = unpackavx2;
+			kernelname = "avx2";
+		}
+#endif
+	}
+};
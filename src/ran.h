@@ -108,6 +108,12 @@ struct Ranhash
 		return 5.42101086242752217E-20 * int64(u);
 	}
 };
+inline Ullong streamseed(Ullong seed, Ullong stream)
+{ // seed for a Ran of substream number stream of seed; counter-based, so any substream can be had at once,
+	// in any thread, and (Ranhash being one-to-one) different substreams never get the same seed
+	Ranhash hash;
+	return hash.int64(hash.int64(seed) ^ stream);
+}
 struct Ranbyte
 {
 	Int s[256], i, j, ss;
@@ -0,0 +1,267 @@
+/* usage:
+ReadClusterer rc(reads, skipleft, skipright); // reads [nreads, len], one base (0..3) per byte
+rc.sketchall(nthreads);
+rc.group(minsimilarity);
+rc.consenseall(nthreads);
+rc.clusterid[i]		// cluster of read i, numbered 0.. in order of each cluster's first read
+rc.clustersize[c]	// reads in cluster c
+rc.consensus[c]		// its consensus, zero-padded to len (valid for consensuslen[c] bases)
+Reads are sketched by one-permutation MinHash over their K-mers, skipping the skipleft and
+skipright bases of primer that every read shares (and SLACK more, for primer shifted by indels).  Two reads whose sketches collide in any
+band of ROWS bins, and that then agree in at least minsimilarity of all NBIN bins, are joined,
+and so are their clusters.  A cluster's consensus aligns each of its reads to its medoid,
+within BAND of the diagonal, and votes at each base: which base, whether it was deleted,
+and whether one was inserted before it.
+NRvectors allocate through Python, and of the three steps only group() allocates any (the
+outputs): so it must hold the GIL, as the constructor must, but the other two can release it.
+*/
+
+struct ReadClusterer
+{
+	static const Int K = 10, BINBITS = 6, NBIN = 1 << BINBITS, ROWS = 1, SLACK = 8, BAND = 16, MAXMEDOID = 64;
+	static const Ullong EMPTY = ~0ULL;
+	MatUchar &reads;
+	Int nreads, len, skipleft, skipright, nclusters;
+	Doub minsimilarity;
+	MatUllong sketch;
+	VecInt parent; // union-find forest
+	atomic<Int> next;
+	vector<vector<Int> > members;
+	// outputs
+	VecInt clusterid, clustersize, consensuslen;
+	MatUchar consensus;
+
+	ReadClusterer(MatUchar &readsin, Int skipleftin, Int skiprightin) : reads(readsin), nreads(readsin.nrows()),
+		len(readsin.ncols()), skipleft(skipleftin), skipright(skiprightin), nclusters(0), minsimilarity(0.),
+		sketch(MAX(1, readsin.nrows()), NBIN), parent(readsin.nrows()), next(0), clusterid(readsin.nrows(), 0) {}
+
+	void sketchread(Int i)
+	{ // min hash value in each bin, the bin chosen by the hash's top bits
+		Int j, b, start = skipleft + SLACK, end = len - skipright - SLACK; // SLACK: indels shift the primers
+		Ullong kmer = 0, h, kmask = (1ULL << (2 * K)) - 1;
+		Ranhash hash;
+		for (b = 0; b < NBIN; b++)
+			sketch[i][b] = EMPTY;
+		for (j = start; j < end; j++)
+		{
+			kmer = ((kmer << 2) | (reads[i][j] & 3)) & kmask;
+			if (j - start + 1 < K)
+				continue;
+			h = hash.int64(kmer);
+			b = Int(h >> (64 - BINBITS));
+			h &= (EMPTY >> BINBITS);
+			if (h < sketch[i][b])
+				sketch[i][b] = h;
+		}
+	}
+	Doub similarity(Int i, Int j)
+	{ // estimated Jaccard similarity of the K-mer sets
+		Int b, nsame = 0;
+		for (b = 0; b < NBIN; b++)
+			nsame += (sketch[i][b] != EMPTY && sketch[i][b] == sketch[j][b]);
+		return Doub(nsame) / NBIN;
+	}
+	Int root(Int i)
+	{
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	}
+	void join(Int i, Int j)
+	{
+		i = root(i);
+		j = root(j);
+		if (i != j)
+			parent[MAX(i, j)] = MIN(i, j);
+	}
+	void group(Doub minsimilarityin)
+	{ // for each band, sort reads by the band's key; reads adjacent in the sort are the candidates
+		Int i, b, k;
+		Ullong key;
+		Ranhash hash;
+		vector<pair<Ullong, Int> > keys;
+		minsimilarity = minsimilarityin;
+		for (i = 0; i < nreads; i++)
+			parent[i] = i;
+		for (b = 0; b < NBIN; b += ROWS)
+		{
+			keys.clear();
+			for (i = 0; i < nreads; i++)
+			{
+				for (k = 0, key = 0; k < ROWS; k++)
+				{
+					if (sketch[i][b + k] == EMPTY)
+						break;
+					key = hash.int64(key ^ sketch[i][b + k]);
+				}
+				if (k == ROWS)
+					keys.push_back(make_pair(key, i));
+			}
+			sort(keys.begin(), keys.end());
+			for (k = 1; k < Int(keys.size()); k++)
+				if (keys[k].first == keys[k - 1].first && root(keys[k].second) != root(keys[k - 1].second)
+					&& similarity(keys[k].second, keys[k - 1].second) >= minsimilarity)
+					join(keys[k].second, keys[k - 1].second);
+		}
+		members.clear();
+		for (i = 0; i < nreads; i++)
+		{
+			if (root(i) == i)
+			{
+				clusterid[i] = Int(members.size());
+				members.push_back(vector<Int>());
+			}
+			else
+				clusterid[i] = clusterid[root(i)]; // roots come first, being the smallest index
+			members[clusterid[i]].push_back(i);
+		}
+		nclusters = Int(members.size());
+		clustersize.resize(nclusters); // size the outputs for consenseall
+		consensuslen.resize(nclusters);
+		consensus.resize(MAX(1, nclusters), len);
+		for (i = 0; i < nclusters; i++)
+			clustersize[i] = Int(members[i].size());
+	}
+	Int medoid(const vector<Int> &m)
+	{ // the member most like the others, by sketch
+		Int a, b, n = MIN(Int(m.size()), Int(MAXMEDOID)), best = m[0]; // (a copy: MIN takes references)
+		Doub s, bests = -1.;
+		for (a = 0; a < n; a++)
+		{
+			for (b = 0, s = 0.; b < n; b++)
+				s += (a == b ? 0. : similarity(m[a], m[b]));
+			if (s > bests)
+			{
+				bests = s;
+				best = m[a];
+			}
+		}
+		return best;
+	}
+	void align(const Uchar *c, const Uchar *r, vector<Int> &cost, vector<Uchar> &trace, vector<Int> &base, vector<Int> &ins, vector<Int> &del)
+	{
+		// banded global edit distance of read r against center c, cell (i, d) pairing c[0..i-1]
+		// with r[0..i+d-1]; then trace back, voting for what r has at each base of c (base and
+		// ins hold 4 votes per base of c, one for each of ACGT)
+		const Int W = 2 * BAND + 1, BIG = 1 << 29;
+		Int i, j, d, x, best;
+		Uchar move, lastmove;
+		for (i = 0; i <= len; i++)
+		{
+			for (d = -BAND; d <= BAND; d++)
+			{
+				j = i + d;
+				x = i * W + d + BAND;
+				cost[x] = BIG;
+				trace[x] = 0;
+				if (j < 0 || j > len)
+					continue;
+				if (i == 0 && j == 0)
+				{
+					cost[x] = 0;
+					continue;
+				}
+				if (i > 0 && j > 0 && cost[x - W] < BIG) // same d in row i-1: match or substitution
+				{
+					cost[x] = cost[x - W] + (c[i - 1] != r[j - 1]);
+					trace[x] = 1;
+				}
+				if (i > 0 && d < BAND && (best = cost[x - W + 1] + 1) < cost[x]) // c[i-1] deleted from r
+				{
+					cost[x] = best;
+					trace[x] = 2;
+				}
+				if (j > 0 && d > -BAND && (best = cost[x - 1] + 1) < cost[x]) // r[j-1] inserted before c[i]
+				{
+					cost[x] = best;
+					trace[x] = 3;
+				}
+			}
+		}
+		i = len;
+		d = 0;
+		lastmove = 0;
+		while (i > 0 || d != 0)
+		{
+			move = trace[i * W + d + BAND];
+			j = i + d;
+			if (move == 1)
+			{
+				base[4 * (i - 1) + (r[j - 1] & 3)]++;
+				i--;
+			}
+			else if (move == 2)
+			{
+				del[i - 1]++;
+				i--;
+				d++;
+			}
+			else if (move == 3)
+			{
+				if (lastmove != 3) // one vote per read per slot
+					ins[4 * i + (r[j - 1] & 3)]++;
+				d--;
+			}
+			else
+				break; // unreachable: band too narrow for the ends to meet
+			lastmove = move;
+		}
+	}
+	void consense(Int c, vector<Int> &cost, vector<Uchar> &trace, vector<Int> &base, vector<Int> &ins, vector<Int> &del)
+	{
+		const vector<Int> &m = members[c];
+		Int i, k, b, n = Int(m.size()), half = n / 2, center = medoid(m), clen = 0;
+		Uchar *out = consensus[c];
+		base.assign(4 * (len + 1), 0);
+		ins.assign(4 * (len + 1), 0);
+		del.assign(len + 1, 0);
+		for (k = 0; k < n; k++)
+			align(reads[center], reads[m[k]], cost, trace, base, ins, del);
+		for (i = 0; i <= len; i++)
+		{
+			b = imaxloc(&ins[4 * i]);
+			if (ins[4 * i] + ins[4 * i + 1] + ins[4 * i + 2] + ins[4 * i + 3] > half && clen < len)
+				out[clen++] = Uchar(b);
+			if (i < len && del[i] <= half && clen < len)
+				out[clen++] = Uchar(imaxloc(&base[4 * i]));
+		}
+		consensuslen[c] = clen;
+		for (; clen < len; clen++)
+			out[clen] = 0;
+	}
+	static inline Int imaxloc(const Int *v)
+	{ // first of the most votes among 4
+		Int b, best = 0;
+		for (b = 1; b < 4; b++)
+			if (v[b] > v[best])
+				best = b;
+		return best;
+	}
+	void sketchwork()
+	{
+		Int i;
+		while ((i = next++) < nreads)
+			sketchread(i);
+	}
+	void consensuswork()
+	{ // scratch is this worker's, in std::vectors (see above)
+		Int c;
+		vector<Int> cost((len + 1) * (2 * BAND + 1)), base, ins, del;
+		vector<Uchar> trace((len + 1) * (2 * BAND + 1));
+		while ((c = next++) < nclusters)
+			consense(c, cost, trace, base, ins, del);
+	}
+	void parallel(void (ReadClusterer::*work)(), Int nthreads)
+	{ // as DecodeBatch::run, the calling thread is worker 0
+		Int t;
+		vector<thread> workers;
+		next = 0;
+		for (t = 1; t < nthreads; t++)
+			workers.push_back(thread(work, this));
+		(this->*work)();
+		for (t = 0; t < Int(workers.size()); t++)
+			workers[t].join();
+	}
+	void sketchall(Int nthreads) { parallel(&ReadClusterer::sketchwork, nthreads); }
+	void consenseall(Int nthreads) { parallel(&ReadClusterer::consensuswork, nthreads); } // after group()
+};
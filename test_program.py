@@ -29,6 +29,7 @@ totstrandlen = 300  # total length of DNA strand
 strandIDbytes = 2  # ID bytes each strand for packet and sequence number
 strandrunoutbytes = 2  # confirming bytes end of each strand (see paper)
 hlimit = 1000000  # maximum size of decode heap, see paper
+nthreads = 0  # encoder/decoder threads per packet (0 for one per core)
 leftprimer = "TCGAAGTCAGCGTGTATTGTATG"
 # for direct right appending (no revcomp)
 rightprimer = "TAGTGAGTGCGATTAAGCGTGTT"
@@ -127,15 +128,9 @@ def messtodna(mpacket):
     filler = array([0, 2, 1, 3, 0, 3, 2, 1, 2, 0, 3, 1, 3, 1, 2,
                    0, 2, 3, 1, 0, 3, 2, 1, 0, 1, 3], dtype=uint8)
     dpacket = zeros([strandsperpacket, totstrandlen], dtype=uint8)
-    for i in range(strandsperpacket):
-        dna = code.encode(mpacket[i, :])
-        if len(dna) < totstrandlen:  # need filler after message and before right primer
-            dnaleft = dna[:-rightlen]
-            dnaright = dna[-rightlen:]
-            dna = concatenate(
-                (dnaleft, filler[:totstrandlen-len(dna)], dnaright))
-            # n.b. this can violate the output constraints (very slightly at end of strand)
-        dpacket[i, :len(dna)] = dna
+    # encode all strands at once, with filler after message and before right primer
+    # n.b. this can violate the output constraints (very slightly at end of strand)
+    code.encode_batch(mpacket, totstrandlen, filler, dpacket, nthreads)
     return dpacket
 
 
@@ -146,14 +141,15 @@ def dnatomess(dnapacket):
     mpacket = zeros([strandsperpacket, bytesperstrand], dtype=uint8)
     # everything starts as an erasure
     epacket = ones([strandsperpacket, bytesperstrand], dtype=uint8)
+    # decode all strands of the packet at once, in parallel
+    (errcodes, messes, _, _, _, _, nbytes) = code.decode_batch(
+        dnapacket, 8*bytesperstrand, nthreads)
     for i in range(strandsperpacket):
-        (errcode, mess, _, _, _, _) = code.decode(
-            dnapacket[i, :], 8*bytesperstrand)
-        if errcode > 0:
+        if errcodes[i] > 0:
             baddecodes += 1
-            erasures += max(0, messbytesperstrand-len(mess))
-        lenmin = min(len(mess), bytesperstrand)
-        mpacket[i, :lenmin] = mess[:lenmin]
+            erasures += max(0, messbytesperstrand-nbytes[i])
+        lenmin = min(nbytes[i], bytesperstrand)
+        mpacket[i, :lenmin] = messes[i, :lenmin]
         epacket[i, :lenmin] = 0
     return (mpacket, epacket, baddecodes, erasures)
 